@@ -0,0 +1,400 @@
+// Load generator for ircserv. N clients run the PASS/NICK/USER/CAP END
+// handshake, join M channels and then send PRIVMSGs at a fixed total rate.
+// Every message carries its send time, so the receiving clients measure the
+// delivery latency. Meant to run against a server on the same host:
+//
+//   ./ircload -p 6697 -w pass -c 50 -m 2 -r 10000 -d 5
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+const long LATENCY_BUCKETS = 1000000; // 1us buckets up to one second
+const size_t READ_SIZE = 65536;
+
+struct Options
+{
+    const char *host;
+    int port;
+    const char *password;
+    int clients;
+    int channels;
+    long rate;         // messages per second, all clients together
+    double duration;   // seconds of sending
+    size_t payload;    // padding bytes per message
+};
+
+struct Connection
+{
+    int fd;
+    std::string out;
+    std::string in;
+    bool welcomed;
+    int joined; // RPL_ENDOFNAMES received
+};
+
+static long long NowUs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+class LoadGenerator
+{
+private:
+    Options _options;
+    std::string _prefix; // keeps nicks and channels apart from earlier runs
+    std::vector<Connection> _connections;
+    std::vector<struct pollfd> _pollfds;
+    std::vector<unsigned long> _histogram;
+    long long _maxLatency;
+    unsigned long _sent;
+    unsigned long _received;
+    std::string _padding;
+    const char *_error;
+
+    void HandleLine(Connection &connection, const char *line, size_t length, long long now)
+    {
+        std::string text(line, length);
+        if (text.compare(0, 5, "PING ") == 0)
+        {
+            connection.out += "PONG " + text.substr(5) + "\r\n";
+            return;
+        }
+        size_t command = text.find(' ');
+        if (text.empty() || text[0] != ':' || command == std::string::npos)
+        {
+            if (text.compare(0, 5, "ERROR") == 0)
+                _error = "server closed the connection";
+            return;
+        }
+        if (text.compare(command, 9, " PRIVMSG ") == 0)
+        {
+            size_t body = text.find(" :", command + 9);
+            if (body == std::string::npos)
+                return;
+            long long latency = now - std::strtoll(text.c_str() + body + 2, NULL, 10);
+            if (latency < 0)
+                latency = 0;
+            if (latency > _maxLatency)
+                _maxLatency = latency;
+            _histogram[latency < LATENCY_BUCKETS ? latency : LATENCY_BUCKETS - 1]++;
+            _received++;
+        }
+        else if (text.compare(command, 5, " 001 ") == 0)
+            connection.welcomed = true;
+        else if (text.compare(command, 5, " 366 ") == 0)
+            connection.joined++;
+        else if (text.compare(command, 5, " 464 ") == 0)
+            _error = "password rejected";
+        else if (text.compare(command, 5, " 433 ") == 0)
+            _error = "nickname in use";
+    }
+
+    bool Read(Connection &connection)
+    {
+        char buffer[READ_SIZE];
+        while (true)
+        {
+            ssize_t bytes = recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (bytes == 0 || (bytes == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                return false;
+            if (bytes == -1)
+                break;
+            connection.in.append(buffer, bytes);
+        }
+        long long now = NowUs();
+        size_t start = 0;
+        size_t end;
+        while ((end = connection.in.find('\n', start)) != std::string::npos)
+        {
+            size_t length = end - start;
+            if (length > 0 && connection.in[end - 1] == '\r')
+                length--;
+            HandleLine(connection, connection.in.data() + start, length, now);
+            start = end + 1;
+        }
+        connection.in.erase(0, start);
+        return true;
+    }
+
+    bool Write(Connection &connection)
+    {
+        while (!connection.out.empty())
+        {
+            ssize_t bytes = send(connection.fd, connection.out.data(), connection.out.size(), MSG_NOSIGNAL);
+            if (bytes == -1)
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            connection.out.erase(0, bytes);
+        }
+        return true;
+    }
+
+    // One poll round over every connection
+    bool Pump(int timeoutMs)
+    {
+        for (size_t i = 0; i < _connections.size(); i++)
+        {
+            if (!_connections[i].out.empty())
+                Write(_connections[i]);
+            _pollfds[i].events = POLLIN | (_connections[i].out.empty() ? 0 : POLLOUT);
+        }
+        if (poll(&_pollfds[0], _pollfds.size(), timeoutMs) == -1 && errno != EINTR)
+            return Fail("poll failed");
+        for (size_t i = 0; i < _pollfds.size(); i++)
+        {
+            if (_pollfds[i].revents & POLLOUT)
+                Write(_connections[i]);
+            if ((_pollfds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !Read(_connections[i]))
+                return Fail("server closed the connection");
+        }
+        return _error == NULL;
+    }
+
+    bool Fail(const char *error)
+    {
+        if (_error == NULL)
+            _error = error;
+        return false;
+    }
+
+    bool AllWelcomed() const
+    {
+        for (size_t i = 0; i < _connections.size(); i++)
+            if (!_connections[i].welcomed)
+                return false;
+        return true;
+    }
+
+    bool AllJoined() const
+    {
+        for (size_t i = 0; i < _connections.size(); i++)
+            if (_connections[i].joined < _options.channels)
+                return false;
+        return true;
+    }
+
+    bool WaitFor(bool (LoadGenerator::*done)() const, double seconds, const char *error)
+    {
+        long long deadline = NowUs() + static_cast<long long>(seconds * 1000000);
+        while (!(this->*done)())
+        {
+            if (!Pump(10))
+                return false;
+            if (NowUs() > deadline)
+                return Fail(error);
+        }
+        return true;
+    }
+
+    std::string ChannelName(int index) const
+    {
+        std::ostringstream name;
+        name << "#" << _prefix << "_" << index;
+        return name.str();
+    }
+
+    bool Connect()
+    {
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(_options.port);
+        if (inet_pton(AF_INET, _options.host, &address.sin_addr) != 1)
+            return Fail("invalid host address");
+        for (int i = 0; i < _options.clients; i++)
+        {
+            Connection connection;
+            connection.fd = socket(AF_INET, SOCK_STREAM, 0);
+            connection.welcomed = false;
+            connection.joined = 0;
+            if (connection.fd == -1)
+                return Fail("cannot create socket, raise the open file limit");
+            if (connect(connection.fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1)
+            {
+                close(connection.fd);
+                return Fail("cannot connect to the server");
+            }
+            int one = 1;
+            setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            fcntl(connection.fd, F_SETFL, fcntl(connection.fd, F_GETFL, 0) | O_NONBLOCK);
+
+            std::ostringstream handshake;
+            handshake << "PASS " << _options.password << "\r\n"
+                      << "NICK " << _prefix << "_" << i << "\r\n"
+                      << "USER " << _prefix << " 0 * :ircload\r\n"
+                      << "CAP END\r\n";
+            connection.out = handshake.str();
+            _connections.push_back(connection);
+
+            struct pollfd entry;
+            entry.fd = connection.fd;
+            entry.events = POLLIN;
+            entry.revents = 0;
+            _pollfds.push_back(entry);
+        }
+        return true;
+    }
+
+    void Send(long long now)
+    {
+        Connection &sender = _connections[_sent % _connections.size()];
+        int channel = (_sent / _connections.size()) % _options.channels;
+        char header[64];
+        snprintf(header, sizeof(header), "%lld %lu ", now, _sent);
+        sender.out += "PRIVMSG " + ChannelName(channel) + " :" + header + _padding + "\r\n";
+        _sent++;
+    }
+
+    long long Percentile(double fraction) const
+    {
+        unsigned long rank = static_cast<unsigned long>(_received * fraction);
+        unsigned long seen = 0;
+        for (long i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            seen += _histogram[i];
+            if (seen > rank)
+                return i;
+        }
+        return _maxLatency;
+    }
+
+public:
+    LoadGenerator(const Options &options) : _options(options), _histogram(LATENCY_BUCKETS, 0), _maxLatency(0),
+                                            _sent(0), _received(0), _padding(options.payload, 'x'), _error(NULL)
+    {
+        std::ostringstream prefix;
+        prefix << "lg" << getpid();
+        _prefix = prefix.str();
+    }
+
+    ~LoadGenerator()
+    {
+        for (size_t i = 0; i < _connections.size(); i++)
+            close(_connections[i].fd);
+    }
+
+    const char *error() const
+    {
+        return _error;
+    }
+
+    bool Run()
+    {
+        std::cout << "scenario: " << _options.clients << " clients, " << _options.channels << " channels, "
+                  << _options.rate << " msg/s for " << _options.duration << "s, " << _options.payload << " byte payload" << std::endl;
+        if (!Connect() || !WaitFor(&LoadGenerator::AllWelcomed, 30, "registration timed out"))
+            return false;
+        for (size_t i = 0; i < _connections.size(); i++)
+            for (int channel = 0; channel < _options.channels; channel++)
+                _connections[i].out += "JOIN " + ChannelName(channel) + "\r\n";
+        if (!WaitFor(&LoadGenerator::AllJoined, 60, "joining channels timed out"))
+            return false;
+
+        long long start = NowUs();
+        long long stop = start + static_cast<long long>(_options.duration * 1000000);
+        long long now = start;
+        while (now < stop)
+        {
+            unsigned long due = static_cast<unsigned long>((now - start) * _options.rate / 1000000);
+            while (_sent < due)
+                Send(now);
+            if (!Pump(1))
+                return false;
+            now = NowUs();
+        }
+        double sendSeconds = (now - start) / 1000000.0;
+
+        // Every member but the sender gets a copy, wait until the counts stop moving
+        unsigned long expected = _sent * (_connections.size() - 1);
+        unsigned long lastReceived = _received;
+        long long idleSince = NowUs();
+        while (_received < expected && NowUs() - idleSince < 3000000)
+        {
+            if (!Pump(10))
+                return false;
+            if (_received != lastReceived)
+            {
+                lastReceived = _received;
+                idleSince = NowUs();
+            }
+        }
+        double totalSeconds = (NowUs() - start) / 1000000.0;
+
+        std::cout << "sent " << _sent << " msgs (" << static_cast<long>(_sent / sendSeconds) << "/s), delivered "
+                  << _received << " of " << expected << " (" << static_cast<long>(_received / totalSeconds) << "/s)" << std::endl;
+        if (_received > 0)
+            std::cout << "latency us: p50 " << Percentile(0.5) << " p99 " << Percentile(0.99) << " p999 "
+                      << Percentile(0.999) << " max " << _maxLatency << std::endl;
+        return true;
+    }
+};
+
+static void Usage()
+{
+    std::cerr << "Usage: ./ircload [-h host] [-p port] [-w password] [-c clients] [-m channels]"
+                 " [-r msgs/s] [-d seconds] [-s payload bytes]\n";
+    std::exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    options.host = "127.0.0.1";
+    options.port = 6667;
+    options.password = "1234";
+    options.clients = 50;
+    options.channels = 2;
+    options.rate = 10000;
+    options.duration = 5;
+    options.payload = 64;
+
+    int option;
+    while ((option = getopt(argc, argv, "h:p:w:c:m:r:d:s:")) != -1)
+    {
+        switch (option)
+        {
+        case 'h': options.host = optarg; break;
+        case 'p': options.port = std::atoi(optarg); break;
+        case 'w': options.password = optarg; break;
+        case 'c': options.clients = std::atoi(optarg); break;
+        case 'm': options.channels = std::atoi(optarg); break;
+        case 'r': options.rate = std::atol(optarg); break;
+        case 'd': options.duration = std::atof(optarg); break;
+        case 's': options.payload = std::atol(optarg); break;
+        default: Usage();
+        }
+    }
+    if (optind != argc || options.clients < 2 || options.channels < 1 || options.rate < 1 || options.duration <= 0)
+        Usage();
+
+    // One descriptor per simulated client
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    LoadGenerator generator(options);
+    if (!generator.Run())
+    {
+        std::cerr << "ircload: " << generator.error() << std::endl;
+        return 1;
+    }
+    return 0;
+}
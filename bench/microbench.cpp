@@ -0,0 +1,324 @@
+// In-process microbenchmarks for the per-line hot path: splitting, parsing,
+// dispatch, reply formatting, case folding, the Is* lookups and ban matching.
+// The server is driven through fake clients whose sockets are socketpairs,
+// and every case reports nanoseconds and heap allocations per operation.
+//
+//   ./ircmicro [iterations]
+#include "../inc/Server.hpp"
+#include <cstdio>
+#include <ctime>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+// Every allocation goes through malloc, including operator new and
+// MessageRef, so counting there catches all of them
+static unsigned long AllocationCount = 0;
+
+#ifdef __GLIBC__
+extern "C"
+{
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    AllocationCount++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    AllocationCount++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    AllocationCount++;
+    return __libc_realloc(ptr, size);
+}
+}
+#else
+void *operator new(size_t size) throw(std::bad_alloc)
+{
+    AllocationCount++;
+    void *ptr = std::malloc(size ? size : 1);
+    if (ptr == NULL)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) throw()
+{
+    std::free(ptr);
+}
+#endif
+
+const int CHANNEL_MEMBERS = 100;
+const int BAN_MASKS = 3000; // on #bans, split between nick, address and domain masks
+
+static volatile size_t Sink; // keeps results from being optimized away
+
+struct Fixture
+{
+    Server server;
+    std::vector<Client*> clients;
+    Channel *channel; // #bench, every client is a member
+    Channel *banChannel; // #bans, none of the masks matches a client
+    std::vector<int> peers;
+    std::string line;
+    IrcMessage message;
+    char drain[65536];
+
+    Fixture() : server("6667", "bench")
+    {
+        for (int i = 0; i < CHANNEL_MEMBERS; i++)
+        {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == -1)
+            {
+                perror("socketpair");
+                std::exit(1);
+            }
+            fcntl(pair[0], F_SETFL, fcntl(pair[0], F_GETFL, 0) | O_NONBLOCK);
+            fcntl(pair[1], F_SETFL, fcntl(pair[1], F_GETFL, 0) | O_NONBLOCK);
+            sockaddr_in address;
+            std::memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            Client *client = server.AddClient(pair[0], address);
+            clients.push_back(client);
+            peers.push_back(pair[1]);
+
+            char nick[32];
+            snprintf(nick, sizeof(nick), "user%d", i);
+            Feed(*client, "PASS bench");
+            Feed(*client, std::string("NICK ") + nick);
+            Feed(*client, std::string("USER ") + nick + " 0 * :Bench User");
+            Feed(*client, "CAP END");
+            Feed(*client, "JOIN #bench");
+            Drain();
+        }
+        channel = server.findChannel("#bench");
+
+        Feed(*clients[0], "JOIN #bans");
+        Drain();
+        banChannel = server.findChannel("#bans");
+        MaskList &bans = *banChannel->getMaskList('b');
+        for (int i = 0; i < BAN_MASKS / 3; i++)
+        {
+            char mask[64];
+            snprintf(mask, sizeof(mask), "banned%d!*@*", i);
+            bans.add(mask);
+            snprintf(mask, sizeof(mask), "*!*@10.%d.%d.%d", i / 65536, i / 256 % 256, i % 256);
+            bans.add(mask);
+            snprintf(mask, sizeof(mask), "*!*@*.isp%d.example", i);
+            bans.add(mask);
+        }
+    }
+
+    void Feed(Client &client, const std::string &text)
+    {
+        ParseMessage(text.data(), text.size(), message);
+        server.ProcessCommand(message, &client, LookupCommand(message.command.data, message.command.size));
+    }
+
+    // Empties the fake sockets so that writes never block. Replies are only
+    // written at the end of a loop iteration, which is here.
+    void Drain()
+    {
+        server.FlushPending();
+        for (size_t i = 0; i < peers.size(); i++)
+            while (recv(peers[i], drain, sizeof(drain), 0) > 0)
+                ;
+        for (size_t i = 0; i < clients.size(); i++)
+            server.flushClient(*clients[i]);
+    }
+};
+
+typedef void (*BenchFunction)(Fixture &);
+
+static long long NowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Runs in rounds so that fan-out cases can drain the sockets in between,
+// draining is neither timed nor counted
+static void Measure(const char *name, BenchFunction function, Fixture &fixture, unsigned long iterations)
+{
+    const unsigned long round = 64;
+    for (unsigned long i = 0; i < round; i++)
+        function(fixture);
+    fixture.Drain();
+
+    long long elapsed = 0;
+    unsigned long allocations = 0;
+    for (unsigned long done = 0; done < iterations; done += round)
+    {
+        unsigned long before = AllocationCount;
+        long long start = NowNs();
+        for (unsigned long i = 0; i < round; i++)
+            function(fixture);
+        elapsed += NowNs() - start;
+        allocations += AllocationCount - before;
+        fixture.Drain();
+    }
+    unsigned long count = ((iterations + round - 1) / round) * round;
+    printf("%-28s %10.1f ns/op %8.2f allocs/op\n", name, static_cast<double>(elapsed) / count,
+           static_cast<double>(allocations) / count);
+}
+
+static void BenchSplit(Fixture &)
+{
+    Sink = split("PRIVMSG #bench :hello there, how is everyone doing today", " ").size();
+}
+
+static void BenchParse(Fixture &fixture)
+{
+    static const char line[] = "@time=2024-01-01T00:00:00Z :user0!u@h PRIVMSG #bench :hello there";
+    ParseMessage(line, sizeof(line) - 1, fixture.message);
+    Sink = fixture.message.paramCount;
+}
+
+static void BenchLookup(Fixture &)
+{
+    Sink = LookupCommand("PRIVMSG", 7);
+}
+
+static void BenchDispatchPing(Fixture &fixture)
+{
+    fixture.Feed(*fixture.clients[0], "PING :token");
+}
+
+static void BenchDispatchUnknown(Fixture &fixture)
+{
+    fixture.Feed(*fixture.clients[0], "FOO bar baz");
+}
+
+static void BenchDispatchPrivMsgUser(Fixture &fixture)
+{
+    fixture.Feed(*fixture.clients[0], "PRIVMSG user1 :hello there");
+}
+
+static void BenchDispatchPrivMsgChannel(Fixture &fixture)
+{
+    fixture.Feed(*fixture.clients[0], "PRIVMSG #bench :hello there");
+}
+
+static void BenchReplyPrivMsg(Fixture &)
+{
+    std::string nick("user0"), target("#bench"), text("hello there");
+    Sink = std::string(PRIVMSG(nick, target, text)).size();
+}
+
+static void BenchReplyJoin(Fixture &)
+{
+    std::string nick("user0"), channel("#bench");
+    Sink = std::string(JOIN(nick, channel)).size();
+}
+
+static void BenchReplyNamReply(Fixture &)
+{
+    std::string nick("user0"), channel("#bench"), names("@user0 user1 user2 user3 user4 user5 user6 user7");
+    Sink = std::string(RPL_NAMREPLY(nick, channel, names)).size();
+}
+
+static void BenchFoldCase(Fixture &)
+{
+    Sink = FoldCase("User42").size();
+}
+
+static void BenchFoldCaseInto(Fixture &fixture)
+{
+    FoldCaseInto("#Bench-Channel", fixture.line);
+    Sink = fixture.line.size();
+}
+
+static void BenchIsExistClient(Fixture &fixture)
+{
+    Sink = fixture.server.IsExistClient("user50");
+}
+
+static void BenchIsExistChannel(Fixture &fixture)
+{
+    Sink = fixture.server.IsExistChannel("#bench");
+}
+
+static void BenchFindChannel(Fixture &fixture)
+{
+    Sink = fixture.server.findChannel("#Bench") != NULL;
+}
+
+static void BenchIsInChannel(Fixture &fixture)
+{
+    Sink = fixture.server.IsInChannel(*fixture.clients[50], *fixture.channel);
+}
+
+static void BenchIsOperator(Fixture &fixture)
+{
+    Sink = fixture.server.IsOperator(*fixture.clients[50], *fixture.channel);
+}
+
+static void BenchIsBannedClient(Fixture &fixture)
+{
+    Sink = fixture.server.IsBannedClient(*fixture.clients[50], *fixture.channel);
+}
+
+static void BenchIsBannedClientMasks(Fixture &fixture)
+{
+    Sink = fixture.server.IsBannedClient(*fixture.clients[50], *fixture.banChannel);
+}
+
+struct Benchmark
+{
+    const char *name;
+    BenchFunction function;
+};
+
+static const Benchmark Benchmarks[] = {
+    {"split", BenchSplit},
+    {"ParseMessage", BenchParse},
+    {"LookupCommand", BenchLookup},
+    {"dispatch PING", BenchDispatchPing},
+    {"dispatch unknown", BenchDispatchUnknown},
+    {"dispatch PRIVMSG user", BenchDispatchPrivMsgUser},
+    {"dispatch PRIVMSG #100", BenchDispatchPrivMsgChannel},
+    {"reply PRIVMSG", BenchReplyPrivMsg},
+    {"reply JOIN", BenchReplyJoin},
+    {"reply RPL_NAMREPLY", BenchReplyNamReply},
+    {"FoldCase", BenchFoldCase},
+    {"FoldCaseInto", BenchFoldCaseInto},
+    {"IsExistClient", BenchIsExistClient},
+    {"IsExistChannel", BenchIsExistChannel},
+    {"findChannel", BenchFindChannel},
+    {"IsInChannel", BenchIsInChannel},
+    {"IsOperator", BenchIsOperator},
+    {"IsBannedClient", BenchIsBannedClient},
+    {"IsBannedClient 3k masks", BenchIsBannedClientMasks},
+};
+
+int main(int argc, char *argv[])
+{
+    unsigned long iterations = 200000;
+    if (argc == 2)
+        iterations = std::strtoul(argv[1], NULL, 10);
+    if (argc > 2 || iterations == 0)
+    {
+        std::cerr << "Usage: ./ircmicro [iterations]\n";
+        return 1;
+    }
+    Logger::SetLevel(LogError);
+
+    Fixture fixture;
+    for (size_t i = 0; i < sizeof(Benchmarks) / sizeof(Benchmarks[0]); i++)
+    {
+        // Fan-out queues to and later writes to every member, fewer rounds keep the run short
+        unsigned long count = (Benchmarks[i].function == BenchDispatchPrivMsgChannel) ? iterations / 20 : iterations;
+        Measure(Benchmarks[i].name, Benchmarks[i].function, fixture, count);
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <sys/types.h>
+
+// Byte buffer with separate read and write offsets. Consumed bytes are only
+// reclaimed when the tail runs out of room, so a partial line left over from
+// one recv() stays where it is and the next recv() appends right after it.
+class Buffer
+{
+private:
+    std::vector<char> _data;
+    size_t _readPos;
+    size_t _writePos;
+public:
+    Buffer(size_t initialSize = 0);
+    ~Buffer();
+
+    const char *peek() const;
+    size_t readable() const;
+    size_t capacity() const;
+    void consume(size_t len);
+    void clear();
+
+    char *writePtr();
+    size_t writable() const;
+    void reserve(size_t len);
+    void commit(size_t len);
+    void append(const char *data, size_t len);
+
+    ssize_t readFrom(int fd, size_t chunk);
+    const char *findLine() const;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+
+// Which nicknames and channel names are the same, advertised as CASEMAPPING
+// in RPL_ISUPPORT. A name is folded once, when it is assigned, and the folded
+// key is what the nick and channel maps and every comparison use.
+enum CaseMapping
+{
+    CaseMappingAscii,         // A-Z
+    CaseMappingRfc1459,       // A-Z and []\~ as {}|^
+    CaseMappingStrictRfc1459, // A-Z and []\ as {}|
+};
+
+bool ParseCaseMapping(const std::string &name, CaseMapping &mapping);
+const char *CaseMappingName(CaseMapping mapping);
+
+// Process-wide, set by the Server before any name is folded
+void SetCaseMapping(CaseMapping mapping);
+CaseMapping GetCaseMapping();
+
+// One table lookup per byte. FoldCaseInto() reuses the capacity of folded,
+// so a lookup key costs no allocation once the buffer has grown.
+void FoldCaseInto(const std::string &name, std::string &folded);
+std::string FoldCase(const std::string &name);
@@ -2,6 +2,9 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include "IndexedSet.hpp"
+#include "MaskList.hpp"
+#include "History.hpp"
 
 enum Mode
 {
@@ -16,23 +19,31 @@ class Channel
 private:
     class Client *_operator;
     std::string _key;
-    std::vector<class Client*> _banned;
-    std::vector<class Client*> _members;
+    MaskList _bans;
+    MaskList _exceptions;       // +e, ban exceptions
+    MaskList _inviteExceptions; // +I, may join while +i is set
+    IndexedSet<class Client*> _members;
 public:
     std::string _name;
+    std::string _foldedName; // key of Server::_channels and Client::_channel
     std::string _topic;
     int _mode;
-    unsigned int _clientLimit;
-    
+    unsigned int _clientLimit; // only enforced while the ChannelLimit mode is set
+    History _history; // the latest JOIN, PART and PRIVMSG lines for CHATHISTORY
+    std::string _operatorNick; // folded, outlives the operator's connection in a restored channel
 
-    Channel(std::string ChannelName, class Client &);
+    Channel();
     ~Channel();
 
+    // Channels are recycled by Server's pool, reset() opens a new one. A
+    // channel restored from the state file starts without members or operator.
+    void reset(const std::string &ChannelName);
+    void reset(const std::string &ChannelName, class Client &op);
+
     const std::string &getKey() const;
     void setKey(const std::string &key);
 
-    std::vector<class Client*>& getBanned();
-    std::vector<class Client*>& getMembers();
+    IndexedSet<class Client*>& getMembers();
 
     class Client  *getOperator() const;
     void setOperator(class Client *client);
@@ -40,11 +51,13 @@ public:
     void addMember(class Client &client);
     void removeMember(class Client &client);
 
-    void addBanned(class Client &client);
-    void removeBanned(class Client &client);
+    // The list of a b, e or I mode, NULL for any other mode letter
+    MaskList *getMaskList(char mode);
+    bool isBanned(const class Client &client) const;
+    bool isInviteException(const class Client &client) const;
 
-    bool ChangeBannedMode(Client &banned, const std::string &ModeString, bool isbanned);
+    bool ChangeMaskMode(const std::string &ModeString, const std::string &Mask);
     bool ChangeModeTwoParams(const std::string& ModeString, const std::map<char,int>& modes);
-    bool ChangeModeThreeParams(const std::string& ModeString, const std::string& ModeArg, const std::map<char,int>& modes);
+    bool ChangeModeThreeParams(const std::string& ModeString, const std::string& ModeArg, const std::map<char,int>& modes, unsigned int maxLimit);
 
 };
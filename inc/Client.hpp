@@ -2,8 +2,13 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <deque>
 #include "Channel.hpp"
 #include "Server.hpp"
+#include "Buffer.hpp"
+#include "MessageRef.hpp"
+#include "TimerWheel.hpp"
+#include <sys/uio.h>
 
 enum RegistrationState {
     None,
@@ -19,20 +24,58 @@ private:
 public:
     std::string _hostname;
     std::string _nick;
+    std::string _foldedNick; // key of Server::_nicks
     std::string _username;
+    std::string _foldedMask; // nick!user@host, matched against the channel ban lists
     std::string _realname;
     std::string _invitedchan;
     //std::vector<std::string> _fileinfos;
     enum RegistrationState _status;
     bool _online;
-    std::map<std::string, Channel*> _channel;
+    bool _isOper;
+    bool _messageTags; // CAP message-tags, channel events are sent with their time and msgid
+    bool _batch;       // CAP batch
+    bool _chatHistory; // CAP draft/chathistory, CHATHISTORY needs it and batch
+    std::map<std::string, Channel*> _channel; // keyed by Channel::_foldedName
+    Buffer _input;
+    bool _discardLine; // the input is the rest of a line that was too long
+    std::deque<MessageRef> _sendQueue;
+    size_t _sendOffset; // bytes of _sendQueue.front() already written
+    size_t _sendQueueBytes;
+    int _pollEvents;
+    bool _sendQueueExceeded; // dropped at the end of the loop iteration, nothing more is queued
+    Timer _timer; // registration deadline, then the keepalive
+    unsigned long long _lastActivity; // ms of the last read
+    unsigned long long _pingSentAt;   // ms, 0 when no PING is outstanding
+    unsigned long long _floodTokens;  // thousandths of a token
+    unsigned long long _floodRefilledAt; // ms
+    bool _flushPending; // listed in Server::_pendingFlush
+    unsigned long _fanoutMark; // Server::_fanoutMark of the last common peers fan-out that reached it
+    bool _throttled; // out of tokens, the socket is not read
+    Timer _floodTimer; // ends the throttling
+    int _shard; // reactor thread owning the socket, multi-threaded mode only
+    unsigned int _generation; // tells the connections on a reused socket apart
+    // io_uring only: the operations in flight, the client is released once
+    // the last one completes
+    bool _recvArmed;
+    bool _hangupArmed;    // poll for a hang-up, armed instead of the recv while throttled
+    size_t _sendInFlight; // leading _sendQueue entries handed to the kernel
+    bool _closing;        // removed from the server, waiting for its operations
+    std::vector<struct iovec> _sendIov;
+    struct msghdr _sendMsg;
 
-    Client(int clientSocket);
+    Client();
     ~Client();
 
+    // Clients are recycled by Server's pool, reset() gives a fresh connection
+    void reset(int clientSocket);
+
     //getter setter
     int getSocketFd() const;
+    size_t memoryUsage() const;
 
-    void addHostname(sockaddr_in& serverAddress);
+    void addHostname(const sockaddr_in& clientAddress);
+    // Rebuilds _foldedMask, after every change of the nick or the username
+    void updateMask();
 
 };
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstddef>
+
+class Server;
+class Client;
+
+typedef void (Server::*CommandHandler)(Client &, const std::vector<std::string> &);
+
+// Order of CommandTable, CommandCount doubles as "unknown command"
+enum CommandId
+{
+    CmdCap,
+    CmdPass,
+    CmdNick,
+    CmdUser,
+    CmdPing,
+    CmdQuit,
+    CmdJoin,
+    CmdPart,
+    CmdTopic,
+    CmdNames,
+    CmdInvite,
+    CmdMode,
+    CmdKick,
+    CmdNotice,
+    CmdPrivMsg,
+    CmdList,
+    CmdOper,
+    CmdStats,
+    CmdPong,
+    CmdChatHistory,
+    CommandCount
+};
+
+struct CommandEntry
+{
+    const char *name;
+    CommandHandler handler;
+};
+
+extern const CommandEntry CommandTable[CommandCount];
+
+CommandId LookupCommand(const char *name, size_t length);
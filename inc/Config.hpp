@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <exception>
+#include "Logger.hpp"
+#include "CaseMapping.hpp"
+#include "Commands.hpp"
+
+// Server limits and tunables. Every field has a built-in default and can be
+// overridden from a "key = value" file given as the third argument of
+// ircserv; a 0 limit means unlimited.
+class Config
+{
+public:
+    unsigned int maxChannelsPerUser;  // chanlimit
+    unsigned int maxChannelUsers;     // max_channel_users, also caps MODE +l
+    unsigned int registrationTimeout; // registration_timeout, seconds to finish PASS/NICK/USER
+    unsigned int pingInterval;        // ping_interval, seconds of silence before the server PINGs
+    unsigned int pingTimeout;         // ping_timeout, seconds to answer that PING
+    unsigned int sendQueue;           // sendq, bytes queued for a registered user before it is dropped
+    unsigned int sendQueueOper;       // sendq_oper, the same for opers
+    unsigned int sendQueueUnregistered; // sendq_unregistered, the same before registration
+    unsigned int floodRate;           // flood_rate, tokens a client earns per second
+    unsigned int floodBurst;          // flood_burst, tokens a client can save up
+    unsigned int commandCosts[CommandCount]; // cost_<command>, tokens per line
+    unsigned int reactorThreads;      // reactor_threads, network I/O threads, 0 does it all in one thread
+    unsigned int historyLength;       // history_length, events each channel keeps for CHATHISTORY
+    unsigned int snapshotInterval;    // snapshot_interval, seconds between state snapshots
+    LogLevel logLevel;                // log_level: debug, info, warning or error
+    CaseMapping caseMapping;          // casemapping: ascii, rfc1459 or strict-rfc1459
+    std::string operName;             // oper_name, OPER is disabled while empty
+    std::string operPassword;         // oper_password
+    std::string metricsSocket;        // metrics_socket, unix socket path, none when empty
+    std::string stateFile;            // state_file, base path of the channel journal and snapshot, none when empty
+
+    Config();
+
+    void Load(const std::string &Path);
+    void Set(const std::string &Key, const std::string &Value);
+
+    class InvalidConfigException : public std::exception
+    {
+    private:
+        std::string _message;
+    public:
+        InvalidConfigException(const std::string &message);
+        virtual ~InvalidConfigException() throw();
+        virtual const char *what() const throw();
+    };
+};
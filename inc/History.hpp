@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "MessageRef.hpp"
+
+// One channel event as it was broadcast: the tagged line the members got,
+// shared with their send queues, and how many bytes of it are the tags
+struct HistoryEntry
+{
+    MessageRef line;
+    unsigned long long msgid;
+    unsigned long long timeMs; // wall clock, the time tag
+    size_t tagLength;
+
+    HistoryEntry();
+};
+
+// Bounded ring of a channel's latest events for CHATHISTORY. The entries
+// grow with the channel's traffic up to the capacity and are then
+// overwritten in place; a pooled Channel keeps them for its next use. An
+// entry only holds a reference to the broadcast block, so keeping a line
+// costs no copy. msgids and times only grow, both are found by binary search.
+class History
+{
+private:
+    std::vector<HistoryEntry> _entries;
+    size_t _capacity;
+    size_t _first; // oldest entry once the ring is full
+public:
+    History();
+
+    // Empties the ring and makes room for capacity events, 0 keeps none
+    void reset(size_t capacity);
+    void clear();
+    void record(const MessageRef &line, size_t tagLength, unsigned long long msgid, unsigned long long timeMs);
+
+    size_t size() const;
+    const HistoryEntry &operator[](size_t pos) const; // 0 is the oldest
+    size_t findMsgid(unsigned long long msgid) const; // first entry with an id >= msgid
+    size_t findTime(unsigned long long timeMs) const; // first entry at or after timeMs
+};
+
+// IRCv3 server-time, e.g. 2024-01-01T12:00:00.000Z
+unsigned long long RealtimeMs();
+// Writes 24 characters and the terminator
+void FormatServerTime(unsigned long long timeMs, char *out, size_t size);
+bool ParseServerTime(const std::string &text, unsigned long long &timeMs);
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <tr1/unordered_map>
+
+// Elements kept densely in a vector plus a hash index of their positions.
+// insert, erase and contains are O(1) and iterating walks contiguous memory,
+// which is what channel fan-out does on every message. erase() moves the
+// last element into the hole, so the order of the others is not kept.
+template <typename T>
+class IndexedSet
+{
+private:
+    std::vector<T> _items;
+    std::tr1::unordered_map<T, size_t> _index;
+public:
+    typedef typename std::vector<T>::iterator iterator;
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    bool insert(const T &item)
+    {
+        if (_index.find(item) != _index.end())
+            return false;
+        _index[item] = _items.size();
+        _items.push_back(item);
+        return true;
+    }
+
+    bool erase(const T &item)
+    {
+        typename std::tr1::unordered_map<T, size_t>::iterator found = _index.find(item);
+        if (found == _index.end())
+            return false;
+        size_t pos = found->second;
+        _index.erase(found);
+        if (pos != _items.size() - 1)
+        {
+            _items[pos] = _items.back();
+            _index[_items[pos]] = pos;
+        }
+        _items.pop_back();
+        return true;
+    }
+
+    bool contains(const T &item) const
+    {
+        return _index.find(item) != _index.end();
+    }
+
+    void clear()
+    {
+        _items.clear();
+        _index.clear();
+    }
+
+    size_t size() const { return _items.size(); }
+    bool empty() const { return _items.empty(); }
+    const T &front() const { return _items.front(); }
+    const T &operator[](size_t pos) const { return _items[pos]; }
+
+    iterator begin() { return _items.begin(); }
+    iterator end() { return _items.end(); }
+    const_iterator begin() const { return _items.begin(); }
+    const_iterator end() const { return _items.end(); }
+};
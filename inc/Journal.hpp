@@ -0,0 +1,121 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <pthread.h>
+#include "MpscQueue.hpp"
+
+// What a journal record changes. Every record carries absolute state, so
+// replaying one that a snapshot already holds changes nothing.
+enum JournalRecordType
+{
+    RecordCreate = 1,  // text: the operator's folded nick
+    RecordDrop,
+    RecordTopic,       // text: the topic
+    RecordModes,       // a: the mode bits, b: the +l limit, text: the +k key
+    RecordMask,        // a: b, e or I, b: 1 added or 0 removed, text: the mask
+    RecordOperator,    // text: the operator's folded nick
+};
+
+struct JournalRecord
+{
+    JournalRecordType type;
+    unsigned int a;
+    unsigned int b;
+    std::string channel;
+    std::string text;
+};
+
+// A file mapped read-only for the restore, empty when it does not exist
+class MappedFile
+{
+private:
+    const char *_data;
+    size_t _size;
+
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool map(const std::string &path);
+    const char *data() const;
+    size_t size() const;
+};
+
+// Append-only log of the channel state changes, <base>.journal, next to a
+// compact image of all channels, <base>.snapshot. append() only encodes into
+// a buffer; flush() hands the buffer to a writer thread once per loop
+// iteration, which writes and fdatasyncs it in one go. A snapshot goes
+// through the same queue in slices: once it is safely renamed into place the
+// part of the journal it replaces is cut. Nothing is dropped when the queue
+// is full, the chunks wait for the next flush().
+class Journal
+{
+private:
+    enum ChunkType
+    {
+        ChunkRecords,
+        ChunkSnapshotBegin,
+        ChunkSnapshotData,
+        ChunkSnapshotEnd,
+    };
+
+    struct Chunk
+    {
+        std::string *data;
+        ChunkType type;
+    };
+
+    std::string _journalPath;
+    std::string _snapshotPath;
+    std::string *_pending;         // records of the current loop iteration
+    std::vector<Chunk> _backlog;   // chunks the queue had no room for, in order
+    MpscQueue<Chunk> *_queue;
+    pthread_t _thread;
+    int _running;
+    int _fd;
+    unsigned long _records;        // appended since the last snapshot began
+    // Owned by the writer: the snapshot being written and the journal size
+    // when it began, what the journal holds past that is kept
+    int _snapshotFd;
+    long long _snapshotStart;
+
+    static void *WriterLoop(void *journal);
+    void write(const Chunk &chunk);
+    void startSnapshot();
+    void writeSnapshot(const std::string &data);
+    void finishSnapshot(const std::string &header);
+    void cutJournal();
+    void push(std::string *data, ChunkType type);
+
+    Journal(const Journal &);
+    Journal &operator=(const Journal &);
+public:
+    Journal();
+    ~Journal();
+
+    // Opens <base>.journal for appending and starts the writer
+    bool open(const std::string &base);
+    bool isOpen() const;
+    void close();
+
+    void append(JournalRecordType type, unsigned int a, unsigned int b, const std::string &channel, const std::string &text);
+    void flush();
+    // A snapshot is handed over in slices across loop iterations, so the
+    // image is never built in one go. Every record appended before
+    // beginSnapshot() must be in the image; the ones appended while it is
+    // written stay in the journal and are replayed over it, which is safe
+    // because every record carries absolute state. endSnapshot() writes the
+    // header over the start of the image. Both take ownership of the data.
+    void beginSnapshot();
+    void snapshotData(std::string *data);
+    void endSnapshot(std::string *header);
+    unsigned long records() const;
+
+    // Reads <base>.journal up to the first torn or corrupt record and cuts
+    // the file there, so that the next run appends after a valid record
+    static bool Replay(const std::string &base, std::vector<JournalRecord> &records);
+    static std::string SnapshotPath(const std::string &base);
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+
+enum LogLevel
+{
+    LogDebug,
+    LogInfo,
+    LogWarning,
+    LogError
+};
+
+// make NO_DEBUG_LOG=1 removes the per-line debug traces from the binary
+#ifndef IRC_DEBUG_LOG
+# define IRC_DEBUG_LOG 1
+#endif
+
+#define LOG_DEBUG(...) do { if (IRC_DEBUG_LOG && Logger::Enabled(LogDebug)) Logger::Write(LogDebug, __VA_ARGS__); } while (0)
+#define LOG_INFO(...) do { if (Logger::Enabled(LogInfo)) Logger::Write(LogInfo, __VA_ARGS__); } while (0)
+#define LOG_WARNING(...) do { if (Logger::Enabled(LogWarning)) Logger::Write(LogWarning, __VA_ARGS__); } while (0)
+#define LOG_ERROR(...) do { if (Logger::Enabled(LogError)) Logger::Write(LogError, __VA_ARGS__); } while (0)
+
+// Leveled logger that never blocks the caller. Write() formats the record
+// into a slot of a lock-free ring and returns; a background thread drains the
+// ring and writes the records out in batches. When the ring is full the
+// record is dropped and counted instead of waiting.
+class Logger
+{
+public:
+    static void Start(LogLevel level);
+    static void Stop();
+
+    static void SetLevel(LogLevel level);
+    static bool Enabled(LogLevel level);
+    static bool ParseLevel(const char *name, LogLevel &level);
+
+    static void Write(LogLevel level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+    static unsigned long Dropped();
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <tr1/unordered_map>
+#include <tr1/unordered_set>
+
+// A channel's ban (+b), ban exception (+e) or invite exception (+I) list of
+// nick!user@host masks, where * matches any run of characters and ? any one.
+// A mask is folded and compiled when it is added. Matching a client is then
+// one hash lookup for the masks without wildcards and a walk down two tries,
+// keyed by the literal prefix and the literal suffix of the other masks, so
+// only the globs that can match are tried however long the list is. The
+// index is allocated with the first mask, and masks restored by load() are
+// only folded and indexed by the next lookup, so a restart does not pay for
+// the lists of channels nobody joins.
+class MaskList
+{
+private:
+    struct Glob
+    {
+        std::string pattern; // folded
+        std::vector<std::pair<size_t, size_t> > segments; // offset and length of each run between stars
+        bool hasStar;
+        bool anchoredStart;
+        bool anchoredEnd;
+
+        void compile(const std::string &folded);
+        bool matches(const std::string &text) const;
+    };
+
+    // The globs hang off the node their key ends at, a text is matched
+    // against the globs of every node on its own path
+    struct Trie
+    {
+        std::vector<std::vector<Glob> > nodes;
+        std::tr1::unordered_map<size_t, size_t> edges; // node * 256 + byte
+
+        Trie();
+        void clear();
+        std::vector<Glob> &at(const std::string &key);
+        std::vector<Glob> *find(const std::string &key);
+        bool matches(const std::string &text, bool reversed) const;
+    };
+
+    // tr1::hash<std::string> takes its argument by value, which allocates
+    // for any hostmask too long for the small string buffer
+    struct StringHash
+    {
+        size_t operator()(const std::string &text) const;
+    };
+
+    struct Entry
+    {
+        std::string mask;   // as it was set, for the list replies
+        std::string folded;
+    };
+
+    struct Index
+    {
+        // Every folded mask. A text equal to a mask is matched by it, so
+        // this alone decides the masks without wildcards.
+        std::tr1::unordered_set<std::string, StringHash> exact;
+        Trie prefixes;
+        Trie suffixes; // keys reversed
+    };
+
+    // Lookups bring the index up to date, hence mutable
+    mutable std::vector<Entry> _entries;
+    mutable size_t _indexed; // the entries from here on came from load()
+    mutable Index *_index;
+
+    std::vector<Glob> *globsOf(const std::string &folded, bool create) const;
+    bool insert(const std::string &folded) const;
+    void index() const;
+
+    MaskList(const MaskList &);
+    MaskList &operator=(const MaskList &);
+public:
+    MaskList();
+    ~MaskList();
+
+    // false when the mask is already listed, or not listed for remove()
+    bool add(const std::string &mask);
+    bool remove(const std::string &mask);
+    // Appends a mask without checking it, e.g. one read back from a snapshot
+    void load(const std::string &mask);
+    bool matches(const std::string &foldedHostmask) const;
+    void clear();
+
+    size_t size() const;
+    const std::string &operator[](size_t pos) const;
+};
+
+// nick, nick!user and user@host completed to a full nick!user@host mask
+std::string NormalizeMask(const std::string &mask);
@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <cstddef>
+#include <sys/uio.h>
+
+// Handle to the immutable wire bytes of one outgoing line, CRLF included.
+// The bytes live in a single reference counted block, so a line broadcast to
+// a channel is serialised once and every member's send queue only holds a
+// pointer to the same block. The count is atomic, so references can be
+// handed to the reactor threads and dropped there. A reference may start
+// past the beginning of the block, which is how the same tagged line is
+// sent without its tags to clients that did not ask for them.
+class MessageRef
+{
+private:
+    struct Block
+    {
+        size_t refs;
+        size_t length;
+        char data[1];
+    };
+    Block *_block;
+    size_t _offset;
+
+    void init(const char *prefix, size_t prefixLength, const char *line, size_t length, bool terminate = true);
+    void release();
+public:
+    MessageRef();
+    explicit MessageRef(const std::string &line);
+    MessageRef(const char *line, size_t length);
+    // prefix and line joined into one block, for tags in front of a line
+    MessageRef(const char *prefix, size_t prefixLength, const std::string &line);
+    MessageRef(const MessageRef &other);
+    MessageRef &operator=(const MessageRef &other);
+    ~MessageRef();
+
+    const char *data() const;
+    size_t size() const;
+    bool empty() const;
+    size_t useCount() const;
+    // The same block without its first bytes
+    MessageRef skip(size_t bytes) const;
+    // Bytes without the CRLF, queued right before the reference that ends
+    // the line, e.g. a tag in front of a line kept in the history
+    static MessageRef Fragment(const std::string &bytes);
+};
+
+// Lines handed to a single writev() or sendmsg()
+const size_t MAX_WRITE_IOV = 64;
+
+// Send queue helpers shared by the event loops. GatherQueue() points iov at
+// the unwritten bytes of the first messages and returns how many it took,
+// WriteQueue() writes them with one gathering sendmsg() (writev() has no
+// MSG_NOSIGNAL) and ConsumeQueue() pops what a write took off the front.
+size_t GatherQueue(const std::deque<MessageRef> &queue, size_t offset, struct iovec *iov, size_t max);
+ssize_t WriteQueue(int fd, const std::deque<MessageRef> &queue, size_t offset);
+void ConsumeQueue(std::deque<MessageRef> &queue, size_t &offset, size_t sent);
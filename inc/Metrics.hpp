@@ -0,0 +1,68 @@
+#pragma once
+#include <ctime>
+#include <cstddef>
+#include "Commands.hpp"
+
+// Log-linear histogram in the spirit of HdrHistogram. A value lands in the
+// bucket picked by its highest set bit and the SUB_BUCKET_BITS bits below
+// it, so every bucket is within 1/16 of the values it holds and record() is
+// a count-leading-zeros, a shift and an increment. Values are capped at
+// 2^MAX_BITS - 1.
+class Histogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAX_BITS = 40; // about 18 minutes in nanoseconds
+    static const int BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+private:
+    unsigned long _counts[BUCKETS];
+    unsigned long _count;
+    unsigned long long _sum;
+    unsigned long long _max;
+
+    static unsigned long long UpperBound(int bucket);
+public:
+    Histogram();
+
+    void record(unsigned long long value);
+    unsigned long count() const;
+    unsigned long long sum() const;
+    unsigned long long max() const;
+    // Upper bound of the bucket holding that fraction of the values
+    unsigned long long percentile(double fraction) const;
+};
+
+// Counters of the running server, exposed through STATS and the metrics
+// socket. Plain integers: they are only touched from the event loop.
+struct Metrics
+{
+    time_t startTime;
+    unsigned long connectionsAccepted;
+    unsigned long connectionsClosed;
+    unsigned long long bytesIn;
+    unsigned long long bytesOut;
+    unsigned long droppedSends; // queued messages that never reached a dead or closing client
+    unsigned long messagesQueued; // lines put in a send queue
+    unsigned long writeCalls; // send(), writev() or io_uring sendmsg operations writing them
+    unsigned long commandCounts[CommandCount];
+    unsigned long unknownCommands;
+    unsigned long floodThrottled; // times a client ran out of tokens
+    unsigned long sendQueueExceeded; // clients dropped for a full send queue
+    Histogram commandLatency[CommandCount]; // handler time in nanoseconds
+
+    Metrics();
+};
+
+unsigned long long MonotonicNs();
+
+// Sum over every client's send queue, gathered when the metrics are read
+struct SendQueueTotals
+{
+    unsigned long clients; // with output waiting
+    unsigned long messages;
+    unsigned long long bytes;
+    unsigned long long maxBytes;
+    unsigned long long memory; // Client::memoryUsage() of every client
+    unsigned long long maxMemory;
+};
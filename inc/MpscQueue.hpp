@@ -0,0 +1,83 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Bounded lock-free queue for many producer threads and one consumer
+// (Dmitry Vyukov's array queue). Every slot carries a sequence number telling
+// whose turn it is, so producers only contend on one compare-and-swap and
+// never wait for each other. push() fails instead of blocking when full.
+template <typename T>
+class MpscQueue
+{
+private:
+    struct Slot
+    {
+        size_t sequence;
+        T value;
+    };
+    std::vector<Slot> _slots;
+    size_t _mask;
+    char _pad0[64];
+    size_t _enqueuePos;
+    char _pad1[64];
+    size_t _dequeuePos;
+
+    MpscQueue(const MpscQueue &);
+    MpscQueue &operator=(const MpscQueue &);
+public:
+    // capacity is rounded up to a power of two
+    explicit MpscQueue(size_t capacity) : _enqueuePos(0), _dequeuePos(0)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        _slots.resize(size);
+        _mask = size - 1;
+        for (size_t i = 0; i < size; i++)
+            _slots[i].sequence = i;
+    }
+
+    bool push(const T &value)
+    {
+        size_t pos = __atomic_load_n(&_enqueuePos, __ATOMIC_RELAXED);
+        Slot *slot;
+        while (true)
+        {
+            slot = &_slots[pos & _mask];
+            size_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+            long diff = static_cast<long>(sequence) - static_cast<long>(pos);
+            if (diff == 0)
+            {
+                if (__atomic_compare_exchange_n(&_enqueuePos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = __atomic_load_n(&_enqueuePos, __ATOMIC_RELAXED);
+        }
+        slot->value = value;
+        __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Only ever called from the consumer thread
+    bool pop(T &value)
+    {
+        Slot *slot = &_slots[_dequeuePos & _mask];
+        size_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (static_cast<long>(sequence) - static_cast<long>(_dequeuePos + 1) < 0)
+            return false;
+        value = slot->value;
+        slot->value = T();
+        __atomic_store_n(&slot->sequence, _dequeuePos + _mask + 1, __ATOMIC_RELEASE);
+        _dequeuePos++;
+        return true;
+    }
+
+    bool empty() const
+    {
+        const Slot *slot = &_slots[_dequeuePos & _mask];
+        return static_cast<long>(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE)) - static_cast<long>(_dequeuePos + 1) < 0;
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <new>
+#include <cstddef>
+
+// Slab allocator for the server's long-lived objects. Objects are carved out
+// of slabs of SlabSize and constructed the first time they are handed out. A
+// released object goes on the free list still constructed, so its strings,
+// buffers and queues keep their capacity and the next acquire() reuses them
+// without calling the allocator; the caller resets its state. Everything is
+// destroyed with the pool.
+template <typename T, size_t SlabSize = 64>
+class ObjectPool
+{
+private:
+    std::vector<T*> _slabs;
+    std::vector<T*> _free;
+    size_t _constructed;
+
+    ObjectPool(const ObjectPool &);
+    ObjectPool &operator=(const ObjectPool &);
+public:
+    ObjectPool() : _constructed(0)
+    {
+    }
+
+    ~ObjectPool()
+    {
+        for (size_t i = 0; i < _constructed; i++)
+            _slabs[i / SlabSize][i % SlabSize].~T();
+        for (size_t i = 0; i < _slabs.size(); i++)
+            ::operator delete(_slabs[i]);
+    }
+
+    T *acquire()
+    {
+        if (!_free.empty())
+        {
+            T *object = _free.back();
+            _free.pop_back();
+            return object;
+        }
+        if (_constructed == _slabs.size() * SlabSize)
+        {
+            _slabs.push_back(static_cast<T*>(::operator new(sizeof(T) * SlabSize)));
+            _free.reserve(_slabs.size() * SlabSize);
+        }
+        T *object = new (_slabs.back() + _constructed % SlabSize) T();
+        _constructed++;
+        return object;
+    }
+
+    void release(T *object)
+    {
+        _free.push_back(object);
+    }
+
+    size_t inUse() const
+    {
+        return _constructed - _free.size();
+    }
+
+    size_t capacity() const
+    {
+        return _slabs.size() * SlabSize;
+    }
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+const size_t MAX_PARAMS = 15; // RFC 1459
+
+// Non-owning slice of the input buffer
+struct StringView
+{
+    const char *data;
+    size_t size;
+
+    StringView();
+    StringView(const char *data, size_t size);
+
+    bool empty() const;
+    std::string str() const;
+    void assignTo(std::string &dest) const;
+};
+
+// One RFC 1459 / IRCv3 line split in place:
+//   [@tags] [:prefix] COMMAND [middle ...] [:trailing]
+// Every view points into the buffer the line was parsed from, so a message
+// is only valid until that part of the buffer is consumed.
+struct IrcMessage
+{
+    StringView tags;
+    StringView prefix;
+    StringView command;
+    StringView params[MAX_PARAMS];
+    size_t paramCount;
+    bool hasTrailing;
+};
+
+bool ParseMessage(const char *line, size_t length, IrcMessage &message);
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// epoll is Linux only, everything else falls back to select().
+// Build with `make SELECT=1` to force the select() backend on Linux too.
+#if !defined(__linux__) && !defined(USE_SELECT)
+# define USE_SELECT
+#endif
+
+#ifdef USE_SELECT
+# include <sys/select.h>
+#else
+# include <sys/epoll.h>
+#endif
+
+enum PollFlag
+{
+    PollIn = 1,
+    PollOut = 2,
+    PollErr = 4
+};
+
+struct PollEvent
+{
+    int fd;
+    int events;
+};
+
+// Readiness notification for the sockets of the server. A socket is
+// registered once with add() and stays registered until remove(), wait()
+// only reports the sockets which are actually ready.
+class Poller
+{
+private:
+#ifdef USE_SELECT
+    fd_set _readSet;
+    fd_set _writeSet;
+    int _maxFd;
+    std::vector<int> _interest;
+#else
+    int _epollFd;
+    std::vector<struct epoll_event> _ready;
+#endif
+    size_t _count;
+
+    Poller(const Poller &);
+    Poller &operator=(const Poller &);
+public:
+    Poller();
+    ~Poller();
+
+    bool add(int fd, int events);
+    bool modify(int fd, int events);
+    void remove(int fd);
+    int wait(std::vector<PollEvent> &events, int timeoutMs);
+
+    size_t size() const;
+    static const char *backend();
+};
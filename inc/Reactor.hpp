@@ -0,0 +1,144 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <pthread.h>
+#include <netinet/in.h>
+#include "Poller.hpp"
+#include "MessageRef.hpp"
+#include "MpscQueue.hpp"
+
+// A connection is named by its socket, the shard that owns it and the
+// generation the shard gave it when it was accepted. Sockets are reused as
+// soon as they are closed, the generation tells the connections apart.
+
+// What a shard tells the server thread
+enum ShardEventType
+{
+    ShardAccepted,
+    ShardData,
+    ShardClosed,
+    ShardSendQueueExceeded
+};
+
+struct ShardEvent
+{
+    int type;
+    int shard;
+    int fd;
+    unsigned int generation;
+    sockaddr_in address; // ShardAccepted
+    char *data;          // ShardData, malloc()ed, freed by the server thread
+    size_t size;
+};
+
+// What the server thread tells a shard
+enum ShardCommandType
+{
+    ShardSend,
+    ShardPause,
+    ShardResume,
+    ShardClose
+};
+
+struct ShardCommand
+{
+    int type;
+    int fd;
+    unsigned int generation;
+    unsigned int sendQueueLimit; // ShardSend, 0 for none
+    MessageRef message;          // ShardSend
+};
+
+// Wakes a thread sleeping in its poller. Whatever number of notify() calls
+// happen between two clear() write a single byte to the pipe.
+class Wakeup
+{
+private:
+    int _fds[2];
+    int _pending;
+
+    Wakeup(const Wakeup &);
+    Wakeup &operator=(const Wakeup &);
+public:
+    Wakeup();
+    ~Wakeup();
+
+    bool open();
+    int fd() const;
+    void notify(); // any thread
+    void clear();  // owner thread, before it looks at its queue
+};
+
+// One I/O thread of the I/O offload mode. A shard owns its sockets: it
+// accepts from its own SO_REUSEPORT listener, hands what it reads to the
+// server thread and writes the send queues. It never touches IRC state, so
+// parsing, every command and the fan-out still run on the server thread:
+// shards take the system calls off it, and past that one core is the limit.
+class ReactorShard
+{
+private:
+    struct Connection
+    {
+        unsigned int generation;
+        bool open;
+        bool paused;
+        bool exceeded;
+        bool flushPending; // listed in _pendingFlush
+        int pollEvents;
+        std::deque<MessageRef> sendQueue;
+        size_t sendOffset;
+        size_t sendQueueBytes;
+    };
+
+    int _index;
+    int _listenFd;
+    Poller _poller;
+    Wakeup _wakeup;
+    MpscQueue<ShardCommand> _commands;
+    MpscQueue<ShardEvent> &_events;
+    Wakeup &_serverWakeup;
+    std::vector<Connection*> _connections; // indexed by socket, kept once allocated
+    std::deque<ShardEvent> _backlog; // events waiting for room in _events
+    std::vector<int> _pendingFlush; // connections sent something by the last RunCommands()
+    pthread_t _thread;
+    bool _started;
+    int _running;
+    bool _posted; // server thread only: commands since the last Wake()
+    // Written by the shard, read by the server thread for the metrics
+    unsigned long long _bytesOut;
+    unsigned long _droppedSends;
+    unsigned long long _queuedBytes;
+    unsigned long _writeCalls;
+
+    ReactorShard(const ReactorShard &);
+    ReactorShard &operator=(const ReactorShard &);
+
+    static void *Main(void *shard);
+    void Loop();
+    void Accept();
+    void Read(int fd, int events);
+    void Flush(int fd);
+    void UpdateInterest(int fd);
+    void Close(int fd, bool report);
+    void RunCommands();
+    void Emit(const ShardEvent &event);
+    void Emitted(const ShardEvent &event);
+    void EmitBacklog();
+    Connection *find(int fd, unsigned int generation);
+public:
+    ReactorShard(int index, MpscQueue<ShardEvent> &events, Wakeup &serverWakeup);
+    ~ReactorShard();
+
+    bool Start(int port);
+    void Stop();
+
+    // Server thread only. Commands are run in the order they are posted,
+    // Wake() makes the shard look at them.
+    void Post(const ShardCommand &command);
+    void Wake();
+
+    unsigned long long bytesOut() const;
+    unsigned long droppedSends() const;
+    unsigned long long queuedBytes() const;
+    unsigned long writeCalls() const;
+};
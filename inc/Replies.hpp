@@ -2,22 +2,37 @@
 
 
 //----COMMAND_MESSAGES
-#define CAP_LS ":ircserv CAP * LS :"
+#define CAP_LS ":ircserv CAP * LS :message-tags batch draft/chathistory"
+#define CAP_ACK(Nick, Caps) ":ircserv CAP " + Nick + " ACK :" + Caps
+#define CAP_NAK(Nick, Caps) ":ircserv CAP " + Nick + " NAK :" + Caps
+#define FAIL(Command, Code, Context, Description) ":ircserv FAIL " + Command + " " + Code + " " + Context + " :" + Description
 #define NICK(OldNick, NewNick) ":" + OldNick + " NICK " + NewNick
 #define MODE(FromWho, ChanName, ModeStr, Target) ":" + FromWho + " MODE " + ChanName + " " + ModeStr + " " + Target
 #define PRIVMSG(FromWho, To, Message) ":" + FromWho + " PRIVMSG " + To + " :" + Message
 #define INVITE(FromWho, To, ChanName) ":" + FromWho + " INVITE " + To + " " + ChanName
 #define JOIN(Nick, ChanName) ":" + Nick + " JOIN " + ChanName
-#define KICK(Nick, ChanName, KickedNick) ":" + Nick + " KICK " + ChanName + " " + KickedNick
+#define KICK(Nick, ChanName, KickedNick, Reason) ":" + Nick + " KICK " + ChanName + " " + KickedNick + " :" + Reason
 #define PART(Nick, ChanName) ":" + Nick + " PART " + ChanName
+#define PING(Token) "PING :" + Token
+#define CLOSING_LINK(Host, Reason) "ERROR :Closing Link: " + Host + " (" + Reason + ")"
 #define QUIT(Nick, Reason) ":" + Nick + " QUIT :Quit: " + Reason
+#define BATCH_START(Ref, Type, Target) ":ircserv BATCH +" + Ref + " " + Type + " " + Target
+#define BATCH_END(Ref) ":ircserv BATCH -" + Ref
 
 //----REPLIES
 #define RPL_WELCOME(Nick, UserName) ":ircserv 001 " + Nick + " :Welcome to ircserv made by Ataskin and Sciftci, " + Nick + "!" + UserName + "" 
 
-#define TOKENS "CASEMAPPING=ascii, CHANLIMIT=#:4, CHANMODES=b,i,k,l,o,t, PREFIX=(o)@, TARGMAX=NAMES:1,LIST:1,KICK:1,JOIN:1,PRIVMSG:1,NOTICE:1,PART:0,QUIT:0, TOPICLEN=254"
+#define TOKENS(ChanLimit, CaseMapping, HistoryLength) "CASEMAPPING=" + CaseMapping + ", CHANLIMIT=#:" + ChanLimit + ", CHANMODES=beI,k,l,it, CHATHISTORY=" + HistoryLength + ", EXCEPTS, INVEX, PREFIX=(o)@, TARGMAX=NAMES:1,LIST:1,KICK:1,JOIN:1,PRIVMSG:1,NOTICE:1,PART:0,QUIT:0, TOPICLEN=254"
 
-#define RPL_ISUPPORT(Nick)  ":ircserv 005 " + Nick + " " + TOKENS + " :are supported by this server"
+#define RPL_ISUPPORT(Nick, Tokens)  ":ircserv 005 " + Nick + " " + Tokens + " :are supported by this server"
+
+#define RPL_STATSCOMMANDS(Nick, Command, Count) ":ircserv 212 " + Nick + " " + Command + " " + Count
+
+#define RPL_ENDOFSTATS(Nick, Letter) ":ircserv 219 " + Nick + " " + Letter + " :End of /STATS report"
+
+#define RPL_STATSUPTIME(Nick, Uptime) ":ircserv 242 " + Nick + " :Server Up " + Uptime
+
+#define RPL_STATSDEBUG(Nick, Text) ":ircserv 249 " + Nick + " :" + Text
 
 //RPL_LISTSTART (321) "<client> Channel :Users  Name"
 
@@ -39,6 +54,14 @@
 
 #define RPL_INVITING(Nick, InvitedNick, ChanName) ":ircserv 341 " + Nick + " " + InvitedNick + " " + ChanName
 
+#define RPL_INVEXLIST(Nick, ChanName, Mask) ":ircserv 346 " + Nick + " " + ChanName + " " + Mask
+
+#define RPL_ENDOFINVEXLIST(Nick, ChanName) ":ircserv 347 " + Nick + " " + ChanName + " :End of channel invite exception list"
+
+#define RPL_EXCEPTLIST(Nick, ChanName, Mask) ":ircserv 348 " + Nick + " " + ChanName + " " + Mask
+
+#define RPL_ENDOFEXCEPTLIST(Nick, ChanName) ":ircserv 349 " + Nick + " " + ChanName + " :End of channel exception list"
+
 #define RPL_NAMREPLY(Nick, ChanName, PrefixNickList) ":ircserv 353 " + Nick + " = " + ChanName + " :" + PrefixNickList
 
 #define RPL_ENDOFNAMES(Nick, ChanName) ":ircserv 366 " + Nick + " " + ChanName + " :End of /NAMES list"
@@ -47,6 +70,8 @@
 
 #define RPL_ENDOFBANLIST(Nick, ChanName) ":ircserv 368 " + Nick + " " + ChanName + " :End of channel ban list"
 
+#define RPL_YOUREOPER(Nick) ":ircserv 381 " + Nick + " :You are now an IRC operator"
+
 //#define RPL_WHOISMODES(Nicki, Modes) ":ircserv 379 " + Nick + " :is using modes " + Modes 
 
 //----ERRORS
@@ -100,8 +125,12 @@
 
 #define ERR_BADCHANNELKEY(Nick, ChanName) ":ircserv 475 " + Nick + " " + ChanName + " :Cannot join channel (+k)"
 
+#define ERR_NOPRIVILEGES(Nick) ":ircserv 481 " + Nick + " :Permission Denied- You're not an IRC operator"
+
 #define ERR_CHANOPRIVSNEEDED(Nick, ChanName) ":ircserv 482 " + Nick + " " + ChanName + " :You're not channel operator"
 
+#define ERR_NOOPERHOST(Nick) ":ircserv 491 " + Nick + " :No O-lines for your host"
+
 #define ERR_UMODEUNKNOWNFLAG(Nick, Modechar) ":ircserv 501 " + Nick + " " + ModeChar + " :Unknown MODE flag"
 
 #define ERR_INVALIDKEY(Nick, ChanName) ":ircserv 525 " + Nick + " " + ChanName + " :Key is not well-formed"
\ No newline at end of file
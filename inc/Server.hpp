@@ -15,13 +15,26 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include <sys/types.h>
+#include <tr1/unordered_map>
 #include "../inc/Client.hpp"
 #include "../inc/Channel.hpp"
 #include "../inc/Replies.hpp"
 #include "../inc/Utils.hpp"
+#include "../inc/CaseMapping.hpp"
+#include "../inc/Poller.hpp"
+#include "../inc/Config.hpp"
+#include "../inc/Parser.hpp"
+#include "../inc/Commands.hpp"
+#include "../inc/Logger.hpp"
+#include "../inc/ObjectPool.hpp"
+#include "../inc/Metrics.hpp"
+#include "../inc/TimerWheel.hpp"
+#include "../inc/Reactor.hpp"
+#include "../inc/Uring.hpp"
+#include "../inc/Journal.hpp"
 
-const int MAX_CLIENTS = 10; // Maximum number of clients to handle
-const int BUFFER_SIZE = 1024;
+const int BUFFER_SIZE = 4096; // Free space guaranteed to each recv()
+const size_t MAX_LINE_LENGTH = 512; // RFC 1459, including the CRLF
 
  enum Prefix
  {
@@ -30,6 +43,15 @@ const int BUFFER_SIZE = 1024;
     PrefixChannelOp,
  };
 
+// Who does the network I/O: Run() with the Poller, the I/O offload
+// (reactor) threads or the io_uring loop
+enum IoMode
+{
+    IoPoller,
+    IoShards,
+    IoUring,
+};
+
 class Server
 {
 private:
@@ -37,58 +59,173 @@ private:
     int _serverSocketFd;
     int _port;
     std::string _password;
-    std::vector<class Client*> _clients;
-    std::map<std::string, class Channel*> _channels;
+    Config _config;
+    std::string _tokens; // RPL_ISUPPORT
+    std::vector<std::string> _params; // reused by every dispatched command
+    Metrics _metrics;
+    int _metricsSocketFd; // -1 unless metrics_socket is configured
+    ObjectPool<Client> _clientPool;
+    ObjectPool<Channel> _channelPool;
+    std::vector<class Client*> _clients; // indexed by socket, NULL when unused
+    std::tr1::unordered_map<std::string, class Client*> _nicks; // Client::_foldedNick -> client
+    std::map<std::string, class Channel*> _channels; // Channel::_foldedName -> channel
+    std::string _foldBuffer; // key of the last findClient() or findChannel()
+    Poller _poller;
+    unsigned long long _nowMs; // monotonic, taken once per loop iteration
+    TimerWheel _timers;
+    std::vector<Timer*> _expired;
+    std::vector<int> _slowClients; // sockets over their SendQ, dropped by DropSlowClients
+    IoMode _ioMode;
+    std::vector<ReactorShard*> _shards; // reactor threads, empty in the single-threaded mode
+    MpscQueue<ShardEvent> *_shardEvents;
+    Wakeup _shardWakeup;
+    class Uring *_uring; // NULL unless built with URING=1 and the kernel supports it
+    std::vector<Client*> _pendingFlush; // clients with output to write before the next wait
+    bool _multishotAccept;
+    bool _multishotRecv;
+    unsigned long _fanoutMark; // bumped by every sendClientToCommonPeers()
+    // msgid of the latest channel event. Starts at the boot time in
+    // microseconds so that ids stay unique across restarts, unless a run
+    // averaged over 1000 events per millisecond.
+    unsigned long long _lastMsgid;
+    unsigned long _lastBatch; // reference of the latest CHATHISTORY batch
+    Journal _journal; // closed unless state_file is configured
+    Timer _snapshotTimer;
+    bool _snapshotting; // from WriteSnapshot() to the last WriteSnapshotSlice()
+    std::string _snapshotCursor; // folded name of the last channel serialized
+    unsigned int _snapshotChannels;
+    unsigned long long _snapshotSize;
     
 public:
-    const std::map<std::string, void (Server::*)(class Client &, std::vector<std::string>)> cmds;
-
-    Server(const std::string &Port, const std::string &Password);
+    Server(const std::string &Port, const std::string &Password, const Config &config = Config());
     ~Server();
 
     // Server.cpp
-    Server Listen();
+    Server &Listen();
     void Run();
-    void Serve(fd_set readSet);
-    void ProcessCommand(std::string &message, Client *client);
+    void Accept();
+    Client *AddClient(int clientSocket, const sockaddr_in &clientAddress);
+    void Serve(const PollEvent &event);
+    void RemoveClient(Client *client);
+    void Disconnect(Client &client, const std::string &reason);
+    void RunTimers();
+    int WaitTimeoutMs() const;
+    void ClientTimeout(Client &client);
+    bool TakeTokens(Client &client, CommandId command);
+    void Throttle(Client &client, CommandId command);
+    void Resume(Client &client);
+    unsigned int SendQueueLimit(const Client &client) const;
+    void DropSlowClients();
+    void ProcessInput(Client *client);
+    void ProcessCommand(const IrcMessage &message, Client *client, CommandId command);
 
     // Commands
-    void Cap(class Client &, std::vector<std::string>);
-    void Pass(class Client &, std::vector<std::string>);
-    void Nick(class Client &, std::vector<std::string>);
-    void User(class Client &, std::vector<std::string>);
-    void Ping(class Client &, std::vector<std::string>);
-    void Quit(class Client &, std::vector<std::string>);
-    void Join(class Client &, std::vector<std::string>);
-    void Part(class Client &, std::vector<std::string>);
-    void Topic(class Client &, std::vector<std::string>);
-    void Names(class Client &, std::vector< std::string>);
-    void Invite(class Client &, std::vector< std::string>);
-    void Mode(class Client &, std::vector<std::string>);
-    void Kick(class Client &, std::vector<std::string>);
-    void Notice(class Client &, std::vector< std::string>);
-    void PrivMsg(class Client &, std::vector< std::string>);
-    void List(class Client &, std::vector<std::string>);
+    void Cap(class Client &, const std::vector<std::string> &);
+    void Pass(class Client &, const std::vector<std::string> &);
+    void Nick(class Client &, const std::vector<std::string> &);
+    void User(class Client &, const std::vector<std::string> &);
+    void Ping(class Client &, const std::vector<std::string> &);
+    void Quit(class Client &, const std::vector<std::string> &);
+    void Join(class Client &, const std::vector<std::string> &);
+    void Part(class Client &, const std::vector<std::string> &);
+    void Topic(class Client &, const std::vector<std::string> &);
+    void Names(class Client &, const std::vector<std::string> &);
+    void Invite(class Client &, const std::vector<std::string> &);
+    void Mode(class Client &, const std::vector<std::string> &);
+    void Kick(class Client &, const std::vector<std::string> &);
+    void Notice(class Client &, const std::vector<std::string> &);
+    void PrivMsg(class Client &, const std::vector<std::string> &);
+    void List(class Client &, const std::vector<std::string> &);
+    void Oper(class Client &, const std::vector<std::string> &);
+    void Stats(class Client &, const std::vector<std::string> &);
+    void Pong(class Client &, const std::vector<std::string> &);
+    void ChatHistory(class Client &, const std::vector<std::string> &);
+    void SendMaskList(class Client &, class Channel &, char mode);
+
+    // ServerMetrics.cpp
+    void ListenMetrics();
+    void AcceptMetrics();
+    std::string FormatMetrics() const;
+    SendQueueTotals CountSendQueues() const;
+    unsigned long long BytesOut() const;
+    unsigned long DroppedSends() const;
+    unsigned long WriteCalls() const;
+    double WriteCallsPer1k() const;
+
+    // ServerJournal.cpp
+    void RestoreState();
+    bool RestoreSnapshot(const std::string &path);
+    Channel *RestoreChannel(const std::string &ChannelName);
+    void ApplyJournalRecord(const JournalRecord &record);
+    void WriteSnapshot();
+    void WriteSnapshotSlice();
+    void JournalCreate(class Channel &);
+    void JournalDrop(class Channel &);
+    void JournalTopic(class Channel &);
+    void JournalModes(class Channel &);
+    void JournalMask(class Channel &, char mode, bool added, const std::string &Mask);
+    void JournalOperator(class Channel &);
+
+    // ServerReactor.cpp
+    void StartShards();
+    void StopShards();
+    void RunShards();
+    bool HandleShardEvents();
+    Client *FindShardClient(const ShardEvent &event);
+    void PostToShard(Client &client, ShardCommandType type, const MessageRef &message = MessageRef());
+
+    // ServerUring.cpp, make URING=1
+    bool StartUring();
+    void RunUring();
+    void UringArmAccept();
+    void UringArmMetrics();
+    void UringArmRecv(Client &client);
+    void UringCancelRecv(Client &client);
+    void UringArmHangup(Client &client);
+    void UringCancelHangup(Client &client);
+    void UringSend(Client &client);
+    void UringFlush(Client &client);
+    void UringCompletion(const struct io_uring_cqe &cqe);
+    void UringAccepted(int clientSocket);
+    void UringReceived(Client &client, int result, unsigned int flags);
+    void UringSent(Client &client, int result);
+    void UringHangup(Client &client, int result);
+    void UringFinish(Client &client);
 
     // ServerUtils.cpp
     bool IsExistClient(const std::string &Nick);
     bool IsExistChannel(const std::string &ChannelName);
-    bool IsBannedClient(class Client &, const std::string &ChannelName);
-    bool IsInChannel(class Client &, const std::string &ChannelName);
-    bool IsOperator(Client &client, const std::string &ChannelName);
-    bool IsChannelLimitFull(const std::string &ChannelName);
-    bool HasChannelKey(const std::string &ChannelName);
+    bool IsBannedClient(class Client &, class Channel &);
+    bool IsInvited(class Client &, class Channel &);
+    bool IsInChannel(class Client &, class Channel &);
+    bool IsOperator(Client &client, class Channel &);
+    bool IsChannelLimitFull(class Channel &);
+    bool HasTooManyChannels(Client &client);
+    bool HasChannelKey(class Channel &);
     bool PasswordMatched(const std::string &PasswordOrigin, const std::string &PasswordGiven);
-    int ParamsSizeControl(Client& client, const std::string& Command, std::vector<std::string> params, size_t necessary, size_t optional);
+    int ParamsSizeControl(Client& client, const std::string& Command, const std::vector<std::string> &params, size_t necessary, size_t optional);
     enum Prefix PrefixControl(std::string str);
-    Client &findClient(const std::string &NickName);
+    Client *findClient(const std::string &NickName);
+    Channel *findChannel(const std::string &ChannelName);
+    void setClientNick(Client &client, const std::string &NickName);
+    void RemoveFromChannel(Client &client, Channel &chan);
 
     // Send messagges
+    void queueMessage(Client &reciever, const MessageRef &message);
+    void scheduleFlush(Client &client);
+    void FlushPending();
+    void flushClient(Client &client);
+    void DropSendQueue(Client &client);
+    void updateInterest(Client &client);
     void sendServerToClient(Client &reciever, const std::string &message);
-    void sendServerToChannel(const std::string &ChannelName, const std::string &message);
-    void sendClientToChannel(Client &sender, const std::string &ChannelName, const std::string &message);
+    void sendServerToChannel(Channel &chan, const std::string &message);
+    void sendClientToCommonPeers(Client &sender, const std::string &message);
+    void sendChannelEvent(Channel &chan, Client *skip, const std::string &message);
+    void sendHistoryEntry(Client &reciever, const HistoryEntry &entry);
 
     const std::string &getPassword() const;
+    unsigned long getCommandCount(CommandId id) const;
+    unsigned long getUnknownCommandCount() const;
 
     class InvalidPortException : public std::exception
     {
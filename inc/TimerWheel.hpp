@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Intrusive timer node, embedded in whatever it times out. A timer is armed
+// while it is linked into a wheel slot.
+struct Timer
+{
+    Timer *prev;
+    Timer *next;
+    unsigned long long expires; // tick
+    void *owner;
+
+    Timer();
+    bool armed() const;
+};
+
+// Hierarchical timing wheel (Varghese & Lauck): four levels of 64 slots. A
+// timer goes into the coarsest level that can still tell its tick apart and
+// is cascaded one level down each time the finer wheel wraps, so arming,
+// cancelling and expiring are O(1) however many timers there are. One tick
+// is TICK_MS, the horizon is 64^4 ticks.
+class TimerWheel
+{
+public:
+    static const unsigned int TICK_MS = 1000;
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+private:
+    Timer _slots[LEVELS][SLOTS]; // list heads
+    unsigned long long _current; // last tick processed
+    size_t _count;
+
+    void link(Timer &timer);
+    void unlink(Timer &timer);
+    void cascade(int level, unsigned long long tick);
+
+    TimerWheel(const TimerWheel &);
+    TimerWheel &operator=(const TimerWheel &);
+public:
+    explicit TimerWheel(unsigned long long nowMs);
+
+    // (Re)arms the timer, a time in the past fires on the next tick
+    void schedule(Timer &timer, unsigned long long expiresMs);
+    void cancel(Timer &timer);
+    // Runs the wheel up to nowMs, the expired timers are unlinked and appended
+    void advance(unsigned long long nowMs, std::vector<Timer*> &expired);
+    // Poll timeout until the next tick, -1 when nothing is armed
+    int timeoutMs(unsigned long long nowMs) const;
+    size_t size() const;
+};
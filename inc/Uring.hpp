@@ -0,0 +1,60 @@
+#pragma once
+
+// io_uring through the raw system calls, there is no liburing dependency.
+// Only built with `make URING=1`, Linux only.
+#ifdef USE_URING
+#include <linux/io_uring.h>
+#include <cstddef>
+
+// One io_uring instance with its submission and completion rings and a ring
+// of provided receive buffers. sqe() only fills the submission ring, enter()
+// hands everything prepared since the last call to the kernel and waits for
+// completions in the same system call.
+class Uring
+{
+private:
+    int _fd;
+    void *_rings;
+    size_t _ringsSize;
+    io_uring_sqe *_sqes;
+    size_t _sqesSize;
+    unsigned *_sqHead;
+    unsigned *_sqTail;
+    unsigned *_sqArray;
+    unsigned _sqMask;
+    unsigned _sqEntries;
+    unsigned *_cqHead;
+    unsigned *_cqTail;
+    io_uring_cqe *_cqes;
+    unsigned _cqMask;
+    io_uring_buf_ring *_bufferRing;
+    size_t _bufferRingSize;
+    char *_buffers;
+    unsigned _bufferCount;
+    unsigned _bufferSize;
+    unsigned short _bufferTail;
+
+    Uring(const Uring &);
+    Uring &operator=(const Uring &);
+
+    int submit(unsigned waitFor, int timeoutMs);
+    bool testBuffers();
+public:
+    static const unsigned short BufferGroup = 0;
+
+    Uring();
+    ~Uring();
+
+    // Both fail on kernels without the features the server relies on
+    bool open(unsigned entries);
+    bool provideBuffers(unsigned count, unsigned size);
+
+    io_uring_sqe *sqe(); // zeroed, submits what is queued when the ring is full
+    int enter(int timeoutMs); // -1 with errno on failure, a timeout is not one
+    bool next(io_uring_cqe &cqe);
+
+    const char *buffer(unsigned id) const;
+    void recycle(unsigned id);
+    bool bufferRing() const; // false when buffers are provided one by one
+};
+#endif
@@ -0,0 +1,100 @@
+#include "../inc/Buffer.hpp"
+#include <cstring>
+#include <sys/socket.h>
+
+Buffer::Buffer(size_t initialSize) : _data(initialSize), _readPos(0), _writePos(0)
+{
+}
+
+Buffer::~Buffer()
+{
+}
+
+const char *Buffer::peek() const
+{
+    return _data.empty() ? NULL : &_data[_readPos];
+}
+
+size_t Buffer::capacity() const
+{
+    return _data.capacity();
+}
+
+size_t Buffer::readable() const
+{
+    return _writePos - _readPos;
+}
+
+void Buffer::consume(size_t len)
+{
+    if (len >= readable())
+        clear();
+    else
+        _readPos += len;
+}
+
+void Buffer::clear()
+{
+    _readPos = 0;
+    _writePos = 0;
+}
+
+char *Buffer::writePtr()
+{
+    return &_data[_writePos];
+}
+
+size_t Buffer::writable() const
+{
+    return _data.size() - _writePos;
+}
+
+// Makes room for len more bytes: first by sliding the unread bytes back to
+// the front, and only if that is not enough by growing the storage.
+void Buffer::reserve(size_t len)
+{
+    if (writable() >= len)
+        return;
+    if (_readPos > 0)
+    {
+        size_t pending = readable();
+        memmove(&_data[0], &_data[_readPos], pending);
+        _readPos = 0;
+        _writePos = pending;
+        if (writable() >= len)
+            return;
+    }
+    size_t size = _data.empty() ? len : _data.size();
+    while (size - _writePos < len)
+        size *= 2;
+    _data.resize(size);
+}
+
+void Buffer::commit(size_t len)
+{
+    _writePos += len;
+}
+
+void Buffer::append(const char *data, size_t len)
+{
+    reserve(len);
+    memcpy(writePtr(), data, len);
+    commit(len);
+}
+
+ssize_t Buffer::readFrom(int fd, size_t chunk)
+{
+    reserve(chunk);
+    ssize_t bytesRead = recv(fd, writePtr(), writable(), 0);
+    if (bytesRead > 0)
+        commit(bytesRead);
+    return bytesRead;
+}
+
+// Returns the '\n' terminating the first complete line, NULL if none yet
+const char *Buffer::findLine() const
+{
+    if (readable() == 0)
+        return NULL;
+    return static_cast<const char *>(memchr(peek(), '\n', readable()));
+}
@@ -0,0 +1,74 @@
+#include "../inc/CaseMapping.hpp"
+
+static const char *const Names[] = {"ascii", "rfc1459", "strict-rfc1459"};
+
+static CaseMapping Current = CaseMappingAscii;
+static unsigned char Table[256];
+
+static void BuildTable(CaseMapping mapping)
+{
+    for (int c = 0; c < 256; c++)
+        Table[c] = c;
+    for (int c = 'A'; c <= 'Z'; c++)
+        Table[c] = c + ('a' - 'A');
+    if (mapping == CaseMappingAscii)
+        return;
+    Table['['] = '{';
+    Table[']'] = '}';
+    Table['\\'] = '|';
+    if (mapping == CaseMappingRfc1459)
+        Table['~'] = '^';
+}
+
+// The table is ready before main(), for the default mapping
+static struct TableInit
+{
+    TableInit() { BuildTable(Current); }
+} Init;
+
+bool ParseCaseMapping(const std::string &name, CaseMapping &mapping)
+{
+    for (size_t i = 0; i < sizeof(Names) / sizeof(Names[0]); i++)
+    {
+        if (name == Names[i])
+        {
+            mapping = static_cast<CaseMapping>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *CaseMappingName(CaseMapping mapping)
+{
+    return Names[mapping];
+}
+
+void SetCaseMapping(CaseMapping mapping)
+{
+    Current = mapping;
+    BuildTable(mapping);
+}
+
+CaseMapping GetCaseMapping()
+{
+    return Current;
+}
+
+void FoldCaseInto(const std::string &name, std::string &folded)
+{
+    folded.resize(name.size());
+    if (name.empty())
+        return;
+    const unsigned char *in = reinterpret_cast<const unsigned char*>(name.data());
+    char *out = &folded[0];
+    for (size_t i = 0; i < name.size(); i++)
+        out[i] = Table[in[i]];
+}
+
+std::string FoldCase(const std::string &name)
+{
+    std::string folded;
+    FoldCaseInto(name, folded);
+    return folded;
+}
@@ -1,14 +1,30 @@
 #include "../inc/Server.hpp"
 
-Channel::Channel(std::string ChannelName, Client &op)
+Channel::Channel() : _operator(NULL), _mode(ProtectedTopic), _clientLimit(0)
+{
+}
+
+void Channel::reset(const std::string &ChannelName)
 {
     _name = ChannelName;
-    _topic = "";
+    FoldCaseInto(ChannelName, _foldedName);
+    _topic.clear();
     _mode = ProtectedTopic;
-    _clientLimit = 16;
-    _key = "";
-    _operator = &op;
-    op._channel[ChannelName] = this;
+    _clientLimit = 0;
+    _key.clear();
+    _bans.clear();
+    _exceptions.clear();
+    _inviteExceptions.clear();
+    _members.clear();
+    _operator = NULL;
+    _operatorNick.clear();
+}
+
+void Channel::reset(const std::string &ChannelName, Client &op)
+{
+    reset(ChannelName);
+    setOperator(&op);
+    op._channel[_foldedName] = this;
 }
 
 
@@ -27,50 +43,43 @@ void Channel::setKey(const std::string &key)
     _key = key;
 }
 
-std::vector<class Client*>& Channel::getBanned()
+IndexedSet<class Client*>& Channel::getMembers() 
 {
-    return _banned;
+    return _members;
 }
 
-std::vector<class Client*>& Channel::getMembers() 
+void Channel::addMember(Client &client)
 {
-    return _members;
+    client._channel.insert(make_pair(_foldedName,this));
+   _members.insert(&client);
 }
 
-void Channel::addMember(Client &client)
+void Channel::removeMember(Client &client)
 {
-    client._channel.insert(make_pair(_name,this));
-   _members.push_back(&client);
+    _members.erase(&client);
+    client._channel.erase(_foldedName);
 }
 
-void Channel::addBanned(Client &client)
+MaskList *Channel::getMaskList(char mode)
 {
-    _banned.push_back(&client);
+    if (mode == 'b')
+        return &_bans;
+    if (mode == 'e')
+        return &_exceptions;
+    if (mode == 'I')
+        return &_inviteExceptions;
+    return NULL;
 }
 
-void Channel::removeMember(Client &client)
+// A ban exception overrides any ban
+bool Channel::isBanned(const Client &client) const
 {
-    for(std::vector<Client*>::iterator it = _members.begin(); it != _members.end(); it++)
-    {
-        if((*it)->_nick == client._nick)
-        {
-            _members.erase(it);
-            break;
-        }
-    }
-    client._channel.erase(_name);
+    return _bans.matches(client._foldedMask) && !_exceptions.matches(client._foldedMask);
 }
 
-void Channel::removeBanned(Client &client)
+bool Channel::isInviteException(const Client &client) const
 {
-    for(std::vector<Client*>::iterator it = _banned.begin(); it != _banned.end(); it++)
-    {
-        if((*it)->_nick == client._nick)
-        {
-            _banned.erase(it);
-            return ;
-        }
-    }
+    return _inviteExceptions.matches(client._foldedMask);
 }
 
  Client  *Channel::getOperator() const
@@ -81,6 +90,8 @@ void Channel::removeBanned(Client &client)
 void Channel::setOperator(Client *client)
 {
     _operator = client;
+    if (client)
+        _operatorNick = client->_foldedNick;
 }
 
 bool Channel::ChangeModeTwoParams(const std::string& ModeString, const std::map<char,int>& modes)
@@ -90,34 +101,34 @@ bool Channel::ChangeModeTwoParams(const std::string& ModeString, const std::map<
         if (ModeString[0] == '+')
             _mode |= modes.at(ModeString[1]);
         else if (ModeString[0] == '-')
-            _mode ^= modes.at(ModeString[1]);
+            _mode &= ~modes.at(ModeString[1]);
     }
     else if (ModeString == "+t" || ModeString == "-t")
     {
         if (ModeString[0] == '+')
             _mode |= modes.at(ModeString[1]);
         else if (ModeString[0] == '-')
-            _mode ^= modes.at(ModeString[1]);
+            _mode &= ~modes.at(ModeString[1]);
     }
     else if (ModeString == "-k" || ModeString == "-l")
     {
-        _mode ^= modes.at(ModeString[1]);
+        _mode &= ~modes.at(ModeString[1]);
         if (ModeString[1] == 'k')
             _key = "";
         else if (ModeString[1] == 'l')
-            _clientLimit = 16;
+            _clientLimit = 0;
     }
     else
         return false;
     return true;
 }
 
-bool Channel::ChangeModeThreeParams(const std::string& ModeString, const std::string& ModeArg, const std::map<char,int>& modes)
+bool Channel::ChangeModeThreeParams(const std::string& ModeString, const std::string& ModeArg, const std::map<char,int>& modes, unsigned int maxLimit)
 {
     if (ModeString == "+l")
     {
         size_t limit = strtol(ModeArg.c_str(), NULL, 10);
-        if (limit > _members.size() && limit <= 16)
+        if (limit > _members.size() && (maxLimit == 0 || limit <= maxLimit))
         {
             _clientLimit = limit;
             _mode |= modes.at(ModeString[1]);
@@ -137,24 +148,15 @@ bool Channel::ChangeModeThreeParams(const std::string& ModeString, const std::st
     return true;
 }
 
-bool Channel::ChangeBannedMode(Client &banned, const std::string &ModeString, bool isbanned)
+// +b, -b, +e, -e, +I or -I with a mask already completed by NormalizeMask()
+bool Channel::ChangeMaskMode(const std::string &ModeString, const std::string &Mask)
 {
-    if (ModeString == "+b")
-    {
-        if(getOperator()->_nick != banned._nick && !isbanned)
-        {
-            addBanned(banned);
-            return true;
-        }
-    }
-    else if (ModeString == "-b")
-    {
-        if(getOperator()->_nick != banned._nick && isbanned)
-        {
-            removeBanned(banned);  
-            return true;
-        }
-    }
+    MaskList *list = (ModeString.size() == 2) ? getMaskList(ModeString[1]) : NULL;
+    if (list == NULL)
+        return false;
+    if (ModeString[0] == '+')
+        return list->add(Mask);
+    if (ModeString[0] == '-')
+        return list->remove(Mask);
     return false;
 }
-
@@ -1,11 +1,54 @@
 #include "../inc/Server.hpp"
 
-Client::Client(int clientSocket) : _hostname("unknown"), _nick(""), _username(""), _realname(""), _invitedchan(""), _status(None) , _online(true)
+Client::Client()
 {
-    _socket = clientSocket;
+    reset(-1);
     //_fileinfos = std::vector<std::string>();
 }
 
+// Assigning and clearing keeps the capacity of the strings, the input buffer
+// and the send queue for the next connection
+void Client::reset(int clientSocket)
+{
+    _socket = clientSocket;
+    _hostname = "unknown";
+    _nick.clear();
+    _foldedNick.clear();
+    _username.clear();
+    _foldedMask.clear();
+    _realname.clear();
+    _invitedchan.clear();
+    _status = None;
+    _online = true;
+    _isOper = false;
+    _messageTags = false;
+    _batch = false;
+    _chatHistory = false;
+    _channel.clear();
+    _input.clear();
+    _discardLine = false;
+    _sendQueue.clear();
+    _sendOffset = 0;
+    _sendQueueBytes = 0;
+    _pollEvents = PollIn;
+    _sendQueueExceeded = false;
+    _timer.owner = this;
+    _lastActivity = 0;
+    _pingSentAt = 0;
+    _floodTokens = 0;
+    _floodRefilledAt = 0;
+    _throttled = false;
+    _floodTimer.owner = this;
+    _shard = 0;
+    _generation = 0;
+    _recvArmed = false;
+    _hangupArmed = false;
+    _sendInFlight = 0;
+    _flushPending = false;
+    _fanoutMark = 0;
+    _closing = false;
+}
+
 Client::~Client()
 {
     //delete this;   
@@ -16,13 +59,31 @@ int Client::getSocketFd() const
     return _socket;
 }
 
-void Client::addHostname(sockaddr_in& serverAddress)
+// Numeric only, a reverse DNS lookup would block the event loop
+void Client::addHostname(const sockaddr_in& clientAddress)
 {
-    char hostname[1024];
-    if (getnameinfo((struct sockaddr *) &serverAddress, sizeof(serverAddress), hostname, 1024, NULL, 0, NI_NUMERICSERV) != 0)
+    char hostname[NI_MAXHOST];
+    if (getnameinfo((const struct sockaddr *) &clientAddress, sizeof(clientAddress), hostname, sizeof(hostname), NULL, 0, NI_NUMERICHOST) != 0)
     {
-        std::cerr << "Error: failed to get client hostname!\n";
+        LOG_WARNING("failed to get client hostname");
         return;
     }
-    _hostname = std::string(hostname);
-}
\ No newline at end of file
+    _hostname.assign(hostname);
+}
+
+// Folded in place, once per change rather than on every ban check
+void Client::updateMask()
+{
+    _foldedMask.assign(_nick).append(1, '!').append(_username).append(1, '@').append(_hostname);
+    FoldCaseInto(_foldedMask, _foldedMask);
+}
+// Bytes held for this client. Queued lines are counted in full although a
+// channel message is shared by every recipient, since that is what this
+// client keeps alive.
+size_t Client::memoryUsage() const
+{
+    size_t strings = _hostname.capacity() + _nick.capacity() + _username.capacity() + _realname.capacity()
+                     + _invitedchan.capacity() + _foldedMask.capacity();
+    size_t channels = _channel.size() * (sizeof(std::pair<const std::string, Channel*>) + 4 * sizeof(void*));
+    return sizeof(Client) + strings + channels + _input.capacity() + _sendQueue.size() * sizeof(MessageRef) + _sendQueueBytes;
+}
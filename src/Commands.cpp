@@ -0,0 +1,94 @@
+#include "../inc/Server.hpp"
+
+const CommandEntry CommandTable[CommandCount] = {
+    {"CAP", &Server::Cap},
+    {"PASS", &Server::Pass},
+    {"NICK", &Server::Nick},
+    {"USER", &Server::User},
+    {"PING", &Server::Ping},
+    {"QUIT", &Server::Quit},
+    {"JOIN", &Server::Join},
+    {"PART", &Server::Part},
+    {"TOPIC", &Server::Topic},
+    {"NAMES", &Server::Names},
+    {"INVITE", &Server::Invite},
+    {"MODE", &Server::Mode},
+    {"KICK", &Server::Kick},
+    {"NOTICE", &Server::Notice},
+    {"PRIVMSG", &Server::PrivMsg},
+    {"LIST", &Server::List},
+    {"OPER", &Server::Oper},
+    {"STATS", &Server::Stats},
+    {"PONG", &Server::Pong},
+    {"CHATHISTORY", &Server::ChatHistory},
+};
+
+// Case-insensitive compare against an upper case command name. Clearing bit
+// 0x20 maps exactly the upper and lower case form of a letter onto the upper
+// case one, and command names are letters only.
+static bool Matches(const char *name, CommandId id)
+{
+    const char *expected = CommandTable[id].name;
+    for (size_t i = 0; expected[i]; i++)
+    {
+        if ((name[i] & 0xDF) != expected[i])
+            return false;
+    }
+    return true;
+}
+
+// Perfect hash on (length, first letter): every key leads to at most one
+// candidate, so a lookup is one or two switches and a single compare.
+// Keep it in sync with CommandTable when adding a command.
+CommandId LookupCommand(const char *name, size_t length)
+{
+    if (length == 0)
+        return CommandCount;
+    CommandId candidate = CommandCount;
+    char first = name[0] & 0xDF;
+    switch (length)
+    {
+    case 3:
+        candidate = CmdCap;
+        break;
+    case 4:
+        switch (first)
+        {
+        case 'P':
+            if ((name[1] & 0xDF) == 'A')
+                candidate = ((name[2] & 0xDF) == 'S') ? CmdPass : CmdPart;
+            else
+                candidate = ((name[1] & 0xDF) == 'O') ? CmdPong : CmdPing;
+            break;
+        case 'N': candidate = CmdNick; break;
+        case 'U': candidate = CmdUser; break;
+        case 'Q': candidate = CmdQuit; break;
+        case 'J': candidate = CmdJoin; break;
+        case 'M': candidate = CmdMode; break;
+        case 'K': candidate = CmdKick; break;
+        case 'L': candidate = CmdList; break;
+        case 'O': candidate = CmdOper; break;
+        }
+        break;
+    case 5:
+        switch (first)
+        {
+        case 'T': candidate = CmdTopic; break;
+        case 'N': candidate = CmdNames; break;
+        case 'S': candidate = CmdStats; break;
+        }
+        break;
+    case 6:
+        candidate = (first == 'I') ? CmdInvite : CmdNotice;
+        break;
+    case 7:
+        candidate = CmdPrivMsg;
+        break;
+    case 11:
+        candidate = CmdChatHistory;
+        break;
+    }
+    if (candidate == CommandCount || !Matches(name, candidate))
+        return CommandCount;
+    return candidate;
+}
@@ -0,0 +1,150 @@
+#include "../inc/Config.hpp"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+
+struct UnsignedOption
+{
+    const char *key;
+    unsigned int Config::*field;
+};
+
+static const UnsignedOption UnsignedOptions[] = {
+    {"chanlimit", &Config::maxChannelsPerUser},
+    {"max_channel_users", &Config::maxChannelUsers},
+    {"registration_timeout", &Config::registrationTimeout},
+    {"ping_interval", &Config::pingInterval},
+    {"ping_timeout", &Config::pingTimeout},
+    {"sendq", &Config::sendQueue},
+    {"sendq_oper", &Config::sendQueueOper},
+    {"sendq_unregistered", &Config::sendQueueUnregistered},
+    {"flood_rate", &Config::floodRate},
+    {"flood_burst", &Config::floodBurst},
+    {"reactor_threads", &Config::reactorThreads},
+    {"history_length", &Config::historyLength},
+    {"snapshot_interval", &Config::snapshotInterval},
+};
+
+struct StringOption
+{
+    const char *key;
+    std::string Config::*field;
+};
+
+static const StringOption StringOptions[] = {
+    {"oper_name", &Config::operName},
+    {"oper_password", &Config::operPassword},
+    {"metrics_socket", &Config::metricsSocket},
+    {"state_file", &Config::stateFile},
+};
+
+static std::string Trim(const std::string &str)
+{
+    size_t begin = str.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+        return "";
+    size_t end = str.find_last_not_of(" \t\r");
+    return str.substr(begin, end - begin + 1);
+}
+
+Config::Config() : maxChannelsPerUser(250), maxChannelUsers(0), registrationTimeout(60),
+                   pingInterval(120), pingTimeout(60), sendQueue(1048576),
+                   sendQueueOper(4194304), sendQueueUnregistered(65536), floodRate(20), floodBurst(40), reactorThreads(0),
+                   historyLength(100), snapshotInterval(300), logLevel(LogInfo), caseMapping(CaseMappingAscii)
+{
+    // Commands that make the server answer with one line per channel, member or message cost more
+    std::fill(commandCosts, commandCosts + CommandCount, 1);
+    commandCosts[CmdNames] = 5;
+    commandCosts[CmdList] = 10;
+    commandCosts[CmdChatHistory] = 10;
+    commandCosts[CmdPong] = 0;
+}
+
+static bool ParseUnsigned(const std::string &Value, unsigned int &number)
+{
+    char *end;
+    errno = 0;
+    unsigned long parsed = std::strtoul(Value.c_str(), &end, 10);
+    if (Value.empty() || *end != '\0' || Value[0] == '-' || errno == ERANGE || parsed > 0xffffffffUL)
+        return false;
+    number = parsed;
+    return true;
+}
+
+void Config::Load(const std::string &Path)
+{
+    std::ifstream file(Path.c_str());
+    if (!file)
+        throw InvalidConfigException("Cannot open config file " + Path);
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+        size_t equal = line.find('=');
+        if (equal == std::string::npos)
+        {
+            std::ostringstream where;
+            where << Path << ":" << lineNumber << ": expected key = value";
+            throw InvalidConfigException(where.str());
+        }
+        Set(Trim(line.substr(0, equal)), Trim(line.substr(equal + 1)));
+    }
+}
+
+void Config::Set(const std::string &Key, const std::string &Value)
+{
+    for (size_t i = 0; i < sizeof(UnsignedOptions) / sizeof(UnsignedOptions[0]); i++)
+    {
+        if (Key != UnsignedOptions[i].key)
+            continue;
+        if (!ParseUnsigned(Value, this->*UnsignedOptions[i].field))
+            throw InvalidConfigException("Invalid value for " + Key + ": " + Value);
+        return;
+    }
+    for (size_t i = 0; i < sizeof(StringOptions) / sizeof(StringOptions[0]); i++)
+    {
+        if (Key != StringOptions[i].key)
+            continue;
+        this->*StringOptions[i].field = Value;
+        return;
+    }
+    if (Key.compare(0, 5, "cost_") == 0)
+    {
+        CommandId command = LookupCommand(Key.c_str() + 5, Key.size() - 5);
+        if (command == CommandCount)
+            throw InvalidConfigException("Unknown command in " + Key);
+        if (!ParseUnsigned(Value, commandCosts[command]))
+            throw InvalidConfigException("Invalid value for " + Key + ": " + Value);
+        return;
+    }
+    if (Key == "log_level")
+    {
+        if (!Logger::ParseLevel(Value.c_str(), logLevel))
+            throw InvalidConfigException("Invalid value for " + Key + ": " + Value);
+        return;
+    }
+    if (Key == "casemapping")
+    {
+        if (!ParseCaseMapping(Value, caseMapping))
+            throw InvalidConfigException("Invalid value for " + Key + ": " + Value);
+        return;
+    }
+    throw InvalidConfigException("Unknown config key " + Key);
+}
+
+Config::InvalidConfigException::InvalidConfigException(const std::string &message) : _message(message + "\n")
+{
+}
+
+Config::InvalidConfigException::~InvalidConfigException() throw()
+{
+}
+
+const char *Config::InvalidConfigException::what() const throw()
+{
+    return _message.c_str();
+}
@@ -0,0 +1,134 @@
+#include "../inc/History.hpp"
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+
+HistoryEntry::HistoryEntry() : msgid(0), timeMs(0), tagLength(0)
+{
+}
+
+History::History() : _capacity(0), _first(0)
+{
+}
+
+void History::reset(size_t capacity)
+{
+    clear();
+    _capacity = capacity;
+}
+
+// Drops the references, the lines are freed once no send queue holds them
+void History::clear()
+{
+    _entries.clear();
+    _first = 0;
+}
+
+void History::record(const MessageRef &line, size_t tagLength, unsigned long long msgid, unsigned long long timeMs)
+{
+    if (_capacity == 0)
+        return;
+    HistoryEntry *entry;
+    if (_entries.size() < _capacity)
+    {
+        _entries.push_back(HistoryEntry());
+        entry = &_entries.back();
+    }
+    else
+    {
+        entry = &_entries[_first];
+        _first = (_first + 1) % _capacity;
+    }
+    entry->line = line;
+    entry->tagLength = tagLength;
+    entry->msgid = msgid;
+    entry->timeMs = timeMs;
+}
+
+size_t History::size() const
+{
+    return _entries.size();
+}
+
+const HistoryEntry &History::operator[](size_t pos) const
+{
+    return _entries[(_first + pos) % _entries.size()];
+}
+
+size_t History::findMsgid(unsigned long long msgid) const
+{
+    size_t low = 0;
+    size_t high = _entries.size();
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if ((*this)[middle].msgid < msgid)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+size_t History::findTime(unsigned long long timeMs) const
+{
+    size_t low = 0;
+    size_t high = _entries.size();
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if ((*this)[middle].timeMs < timeMs)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+unsigned long long RealtimeMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec * 1000ULL + now.tv_nsec / 1000000;
+}
+
+void FormatServerTime(unsigned long long timeMs, char *out, size_t size)
+{
+    time_t seconds = timeMs / 1000;
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    size_t length = strftime(out, size, "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(out + length, size - length, ".%03uZ", static_cast<unsigned int>(timeMs % 1000));
+}
+
+// Milliseconds and the trailing Z are optional
+bool ParseServerTime(const std::string &text, unsigned long long &timeMs)
+{
+    struct tm tm;
+    unsigned int millis = 0;
+    int consumed = 0;
+    if (sscanf(text.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &consumed) != 6)
+        return false;
+    const char *rest = text.c_str() + consumed;
+    if (*rest == '.')
+    {
+        char *end;
+        millis = std::strtoul(rest + 1, &end, 10);
+        if (end != rest + 4)
+            return false;
+        rest = end;
+    }
+    if (*rest == 'Z')
+        rest++;
+    if (*rest != '\0')
+        return false;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = 0;
+    time_t seconds = timegm(&tm);
+    if (seconds == static_cast<time_t>(-1))
+        return false;
+    timeMs = seconds * 1000ULL + millis;
+    return true;
+}
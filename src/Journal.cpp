@@ -0,0 +1,440 @@
+#include "../inc/Journal.hpp"
+#include "../inc/Logger.hpp"
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const size_t JOURNAL_QUEUE_SIZE = 1024;
+const size_t RECORD_HEADER_SIZE = 8; // length of the body, then its checksum
+const size_t MAX_RECORD_SIZE = 1 << 20;
+
+// FNV-1a
+static unsigned int Checksum(const char *data, size_t length)
+{
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    return hash;
+}
+
+// Integers are written in host byte order, the files do not travel
+static void PutU32(std::string &out, unsigned int value)
+{
+    out.append(reinterpret_cast<const char *>(&value), 4);
+}
+
+static void PutString(std::string &out, const std::string &text, const std::string &channel, const char *field)
+{
+    size_t size = text.size();
+    if (size > 0xffff)
+    {
+        LOG_WARNING("Journal record for %s: %s of %lu bytes cut to 65535", channel.c_str(), field, static_cast<unsigned long>(size));
+        size = 0xffff;
+    }
+    unsigned short length = size;
+    out.append(reinterpret_cast<const char *>(&length), 2);
+    out.append(text, 0, length);
+}
+
+static bool GetU32(const char *&data, const char *end, unsigned int &value)
+{
+    if (end - data < 4)
+        return false;
+    memcpy(&value, data, 4);
+    data += 4;
+    return true;
+}
+
+static bool GetString(const char *&data, const char *end, std::string &text)
+{
+    unsigned short length;
+    if (end - data < 2)
+        return false;
+    memcpy(&length, data, 2);
+    if (end - data - 2 < length)
+        return false;
+    text.assign(data + 2, length);
+    data += 2 + length;
+    return true;
+}
+
+static bool WriteAll(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = ::write(fd, data, length);
+        if (written == -1 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+MappedFile::MappedFile() : _data(NULL), _size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data)
+        munmap(const_cast<char *>(_data), _size);
+}
+
+bool MappedFile::map(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return errno == ENOENT;
+    struct stat info;
+    bool mapped = fstat(fd, &info) == 0;
+    if (mapped && info.st_size > 0)
+    {
+        void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+            mapped = false;
+        else
+        {
+            // Read front to back right away
+            madvise(data, info.st_size, MADV_WILLNEED);
+            _data = static_cast<const char *>(data);
+            _size = info.st_size;
+        }
+    }
+    ::close(fd);
+    return mapped;
+}
+
+const char *MappedFile::data() const
+{
+    return _data;
+}
+
+size_t MappedFile::size() const
+{
+    return _size;
+}
+
+Journal::Journal() : _pending(NULL), _queue(NULL), _running(0), _fd(-1), _records(0), _snapshotFd(-1), _snapshotStart(0)
+{
+}
+
+Journal::~Journal()
+{
+    close();
+}
+
+bool Journal::open(const std::string &base)
+{
+    _journalPath = base + ".journal";
+    _snapshotPath = SnapshotPath(base);
+    // Read back when a snapshot keeps the tail of it
+    _fd = ::open(_journalPath.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (_fd == -1)
+    {
+        LOG_ERROR("Failed to open %s: %s", _journalPath.c_str(), strerror(errno));
+        return false;
+    }
+    _queue = new MpscQueue<Chunk>(JOURNAL_QUEUE_SIZE);
+    __atomic_store_n(&_running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&_thread, NULL, WriterLoop, this) != 0)
+    {
+        // Written synchronously by flush() instead
+        __atomic_store_n(&_running, 0, __ATOMIC_RELEASE);
+        LOG_WARNING("Failed to start the journal writer, writing in the event loop");
+    }
+    return true;
+}
+
+bool Journal::isOpen() const
+{
+    return _fd != -1;
+}
+
+// Hands over what is left, lets the writer finish it and joins it
+void Journal::close()
+{
+    if (_fd == -1)
+        return;
+    flush();
+    if (__atomic_load_n(&_running, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&_running, 0, __ATOMIC_RELEASE);
+        pthread_join(_thread, NULL);
+    }
+    for (size_t i = 0; i < _backlog.size(); i++)
+        write(_backlog[i]);
+    _backlog.clear();
+    // A snapshot cut short, the previous one and the journal still hold it all
+    if (_snapshotFd != -1)
+    {
+        ::close(_snapshotFd);
+        _snapshotFd = -1;
+        unlink((_snapshotPath + ".tmp").c_str());
+    }
+    fdatasync(_fd);
+    ::close(_fd);
+    _fd = -1;
+    delete _queue;
+    _queue = NULL;
+}
+
+void Journal::append(JournalRecordType type, unsigned int a, unsigned int b, const std::string &channel, const std::string &text)
+{
+    if (_fd == -1)
+        return;
+    if (_pending == NULL)
+        _pending = new std::string();
+    std::string &out = *_pending;
+    size_t start = out.size();
+    out.append(RECORD_HEADER_SIZE, '\0');
+    out += static_cast<char>(type);
+    PutU32(out, a);
+    PutU32(out, b);
+    PutString(out, channel, channel, "channel");
+    PutString(out, text, channel, "text");
+    unsigned int length = out.size() - start - RECORD_HEADER_SIZE;
+    unsigned int checksum = Checksum(out.data() + start + RECORD_HEADER_SIZE, length);
+    memcpy(&out[start], &length, 4);
+    memcpy(&out[start + 4], &checksum, 4);
+    _records++;
+}
+
+void Journal::push(std::string *data, ChunkType type)
+{
+    Chunk chunk;
+    chunk.data = data;
+    chunk.type = type;
+    if (!__atomic_load_n(&_running, __ATOMIC_ACQUIRE))
+    {
+        write(chunk);
+        fdatasync(_fd);
+        return;
+    }
+    // Keeps the order, nothing overtakes what is already waiting
+    if (_backlog.empty() && _queue->push(chunk))
+        return;
+    _backlog.push_back(chunk);
+}
+
+void Journal::flush()
+{
+    if (_fd == -1)
+        return;
+    if (!_backlog.empty())
+    {
+        size_t pushed = 0;
+        while (pushed < _backlog.size() && _queue->push(_backlog[pushed]))
+            pushed++;
+        _backlog.erase(_backlog.begin(), _backlog.begin() + pushed);
+    }
+    if (_pending == NULL)
+        return;
+    std::string *data = _pending;
+    _pending = NULL;
+    push(data, ChunkRecords);
+}
+
+void Journal::beginSnapshot()
+{
+    flush();
+    _records = 0;
+    if (_fd != -1)
+        push(NULL, ChunkSnapshotBegin);
+}
+
+void Journal::snapshotData(std::string *data)
+{
+    if (_fd == -1)
+        delete data;
+    else
+        push(data, ChunkSnapshotData);
+}
+
+void Journal::endSnapshot(std::string *header)
+{
+    if (_fd == -1)
+        delete header;
+    else
+        push(header, ChunkSnapshotEnd);
+}
+
+unsigned long Journal::records() const
+{
+    return _records;
+}
+
+void *Journal::WriterLoop(void *arg)
+{
+    Journal &journal = *static_cast<Journal *>(arg);
+    Chunk chunk;
+    while (true)
+    {
+        bool running = __atomic_load_n(&journal._running, __ATOMIC_ACQUIRE);
+        bool wrote = false;
+        while (journal._queue->pop(chunk))
+        {
+            journal.write(chunk);
+            wrote = true;
+        }
+        // One sync for everything written in this round
+        if (wrote)
+            fdatasync(journal._fd);
+        else if (!running)
+            break;
+        else
+            usleep(2000);
+    }
+    return NULL;
+}
+
+void Journal::write(const Chunk &chunk)
+{
+    switch (chunk.type)
+    {
+    case ChunkRecords:
+        if (!WriteAll(_fd, chunk.data->data(), chunk.data->size()))
+            LOG_ERROR("Failed to write %s: %s", _journalPath.c_str(), strerror(errno));
+        break;
+    case ChunkSnapshotBegin:
+        startSnapshot();
+        break;
+    case ChunkSnapshotData:
+        writeSnapshot(*chunk.data);
+        break;
+    case ChunkSnapshotEnd:
+        finishSnapshot(*chunk.data);
+        break;
+    }
+    delete chunk.data;
+}
+
+// The image is written under a temporary name and renamed over the old one
+// once synced, a crash leaves either snapshot complete
+void Journal::startSnapshot()
+{
+    std::string temporary = _snapshotPath + ".tmp";
+    if (_snapshotFd != -1)
+        ::close(_snapshotFd);
+    _snapshotStart = lseek(_fd, 0, SEEK_END);
+    _snapshotFd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (_snapshotFd == -1)
+        LOG_ERROR("Failed to write %s: %s", temporary.c_str(), strerror(errno));
+}
+
+void Journal::writeSnapshot(const std::string &data)
+{
+    if (_snapshotFd == -1 || WriteAll(_snapshotFd, data.data(), data.size()))
+        return;
+    std::string temporary = _snapshotPath + ".tmp";
+    LOG_ERROR("Failed to write %s: %s", temporary.c_str(), strerror(errno));
+    ::close(_snapshotFd);
+    _snapshotFd = -1;
+    unlink(temporary.c_str());
+}
+
+void Journal::finishSnapshot(const std::string &header)
+{
+    if (_snapshotFd == -1)
+        return;
+    std::string temporary = _snapshotPath + ".tmp";
+    bool written = pwrite(_snapshotFd, header.data(), header.size(), 0) == static_cast<ssize_t>(header.size())
+                   && fsync(_snapshotFd) == 0;
+    ::close(_snapshotFd);
+    _snapshotFd = -1;
+    if (!written || rename(temporary.c_str(), _snapshotPath.c_str()) == -1)
+    {
+        LOG_ERROR("Failed to write %s: %s", _snapshotPath.c_str(), strerror(errno));
+        unlink(temporary.c_str());
+        return;
+    }
+    cutJournal();
+}
+
+// Drops the records the new snapshot holds. The ones written while it was
+// taken are copied to a new journal renamed over the old one; on any failure
+// the journal stays whole, replaying all of it is harmless.
+void Journal::cutJournal()
+{
+    fdatasync(_fd);
+    long long end = lseek(_fd, 0, SEEK_END);
+    if (end <= _snapshotStart)
+    {
+        if (ftruncate(_fd, 0) == -1)
+            LOG_WARNING("Failed to truncate %s: %s", _journalPath.c_str(), strerror(errno));
+        return;
+    }
+    std::string tail(end - _snapshotStart, '\0');
+    std::string temporary = _journalPath + ".tmp";
+    int fd = -1;
+    bool written = pread(_fd, &tail[0], tail.size(), _snapshotStart) == static_cast<ssize_t>(tail.size())
+                   && (fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600)) != -1
+                   && WriteAll(fd, tail.data(), tail.size()) && fsync(fd) == 0
+                   && rename(temporary.c_str(), _journalPath.c_str()) == 0;
+    if (!written)
+    {
+        LOG_WARNING("Failed to cut %s: %s", _journalPath.c_str(), strerror(errno));
+        if (fd != -1)
+        {
+            ::close(fd);
+            unlink(temporary.c_str());
+        }
+        return;
+    }
+    // Same descriptor number, the event loop only ever checks it for -1
+    dup2(fd, _fd);
+    fcntl(_fd, F_SETFD, FD_CLOEXEC);
+    ::close(fd);
+}
+
+bool Journal::Replay(const std::string &base, std::vector<JournalRecord> &records)
+{
+    std::string path = base + ".journal";
+    MappedFile file;
+    if (!file.map(path))
+    {
+        LOG_ERROR("Failed to read %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    const char *data = file.data();
+    size_t size = file.size();
+    size_t offset = 0;
+    while (size - offset >= RECORD_HEADER_SIZE)
+    {
+        unsigned int length;
+        unsigned int checksum;
+        memcpy(&length, data + offset, 4);
+        memcpy(&checksum, data + offset + 4, 4);
+        if (length > MAX_RECORD_SIZE || size - offset - RECORD_HEADER_SIZE < length)
+            break;
+        const char *body = data + offset + RECORD_HEADER_SIZE;
+        const char *end = body + length;
+        if (length < 1 || Checksum(body, length) != checksum)
+            break;
+        JournalRecord record;
+        record.type = static_cast<JournalRecordType>(static_cast<unsigned char>(*body++));
+        if (!GetU32(body, end, record.a) || !GetU32(body, end, record.b)
+            || !GetString(body, end, record.channel) || !GetString(body, end, record.text))
+            break;
+        records.push_back(record);
+        offset += RECORD_HEADER_SIZE + length;
+    }
+    if (offset < size)
+    {
+        LOG_WARNING("%s: dropping %lu bytes of torn or corrupt records", path.c_str(), static_cast<unsigned long>(size - offset));
+        if (truncate(path.c_str(), offset) == -1)
+            LOG_WARNING("Failed to truncate %s: %s", path.c_str(), strerror(errno));
+    }
+    return true;
+}
+
+std::string Journal::SnapshotPath(const std::string &base)
+{
+    return base + ".snapshot";
+}
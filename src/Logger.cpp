@@ -0,0 +1,207 @@
+#include "../inc/Logger.hpp"
+#include "../inc/MpscQueue.hpp"
+#include <pthread.h>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <strings.h>
+#include <cerrno>
+#include <sys/time.h>
+#include <unistd.h>
+
+const size_t LOG_TEXT_SIZE = 240;   // longer records are truncated
+const size_t LOG_QUEUE_SIZE = 8192;
+const size_t LOG_BATCH_SIZE = 65536;
+
+struct LogRecord
+{
+    int level;
+    struct timeval time;
+    size_t length;
+    char text[LOG_TEXT_SIZE];
+};
+
+static const char *LevelNames[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+static MpscQueue<LogRecord> *Queue = NULL;
+static pthread_t Thread;
+static int Running = 0;
+static int Level = LogInfo;
+static unsigned long DroppedCount = 0;
+
+static void WriteAll(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written == -1 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return;
+        data += written;
+        length -= written;
+    }
+}
+
+static size_t Format(const LogRecord &record, char *out, size_t size)
+{
+    struct tm tm;
+    char stamp[32];
+    gmtime_r(&record.time.tv_sec, &tm);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+    int length = snprintf(out, size, "%s.%03ldZ %-7s %.*s\n", stamp, static_cast<long>(record.time.tv_usec / 1000),
+                          LevelNames[record.level], static_cast<int>(record.length), record.text);
+    if (length < 0)
+        return 0;
+    return (static_cast<size_t>(length) < size) ? length : size - 1;
+}
+
+// Warnings and errors go to stderr, everything else to stdout, one write()
+// per stream and batch.
+struct Batch
+{
+    char out[LOG_BATCH_SIZE];
+    size_t outLength;
+    char err[LOG_BATCH_SIZE];
+    size_t errLength;
+
+    void add(const LogRecord &record)
+    {
+        bool error = record.level >= LogWarning;
+        char *buffer = error ? err : out;
+        size_t &length = error ? errLength : outLength;
+        if (LOG_BATCH_SIZE - length < LOG_TEXT_SIZE + 64)
+            flush();
+        length += Format(record, buffer + length, LOG_BATCH_SIZE - length);
+    }
+
+    void flush()
+    {
+        WriteAll(STDOUT_FILENO, out, outLength);
+        WriteAll(STDERR_FILENO, err, errLength);
+        outLength = 0;
+        errLength = 0;
+    }
+};
+
+static size_t DrainQueue(Batch &batch, unsigned long &reportedDrops)
+{
+    LogRecord record;
+    size_t count = 0;
+    while (Queue->pop(record))
+    {
+        batch.add(record);
+        count++;
+    }
+    unsigned long dropped = __atomic_load_n(&DroppedCount, __ATOMIC_RELAXED);
+    if (dropped != reportedDrops)
+    {
+        record.level = LogWarning;
+        gettimeofday(&record.time, NULL);
+        record.length = snprintf(record.text, LOG_TEXT_SIZE, "logger: %lu records dropped, ring full", dropped - reportedDrops);
+        batch.add(record);
+        reportedDrops = dropped;
+    }
+    batch.flush();
+    return count;
+}
+
+static void *DrainLoop(void *)
+{
+    static Batch batch;
+    unsigned long reportedDrops = 0;
+    while (true)
+    {
+        bool running = __atomic_load_n(&Running, __ATOMIC_ACQUIRE);
+        if (DrainQueue(batch, reportedDrops) == 0)
+        {
+            if (!running)
+                break;
+            usleep(2000);
+        }
+    }
+    return NULL;
+}
+
+void Logger::Start(LogLevel level)
+{
+    SetLevel(level);
+    if (__atomic_load_n(&Running, __ATOMIC_ACQUIRE))
+        return;
+    if (Queue == NULL)
+    {
+        Queue = new MpscQueue<LogRecord>(LOG_QUEUE_SIZE);
+        atexit(Logger::Stop);
+    }
+    __atomic_store_n(&Running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&Thread, NULL, DrainLoop, NULL) != 0)
+        __atomic_store_n(&Running, 0, __ATOMIC_RELEASE);
+}
+
+// Drains what is left and joins the writer thread, later records are
+// written synchronously.
+void Logger::Stop()
+{
+    if (!__atomic_load_n(&Running, __ATOMIC_ACQUIRE))
+        return;
+    __atomic_store_n(&Running, 0, __ATOMIC_RELEASE);
+    pthread_join(Thread, NULL);
+}
+
+void Logger::SetLevel(LogLevel level)
+{
+    __atomic_store_n(&Level, static_cast<int>(level), __ATOMIC_RELAXED);
+}
+
+bool Logger::Enabled(LogLevel level)
+{
+    return static_cast<int>(level) >= __atomic_load_n(&Level, __ATOMIC_RELAXED);
+}
+
+bool Logger::ParseLevel(const char *name, LogLevel &level)
+{
+    for (int i = LogDebug; i <= LogError; i++)
+    {
+        if (strcasecmp(name, LevelNames[i]) == 0)
+        {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Logger::Write(LogLevel level, const char *format, ...)
+{
+    LogRecord record;
+    record.level = level;
+    gettimeofday(&record.time, NULL);
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(record.text, LOG_TEXT_SIZE, format, args);
+    va_end(args);
+    if (length < 0)
+        length = 0;
+    if (static_cast<size_t>(length) >= LOG_TEXT_SIZE)
+    {
+        length = LOG_TEXT_SIZE - 1;
+        memcpy(record.text + length - 3, "...", 3);
+    }
+    record.length = length;
+
+    if (!__atomic_load_n(&Running, __ATOMIC_ACQUIRE))
+    {
+        char line[LOG_TEXT_SIZE + 64];
+        WriteAll(level >= LogWarning ? STDERR_FILENO : STDOUT_FILENO, line, Format(record, line, sizeof(line)));
+        return;
+    }
+    if (!Queue->push(record))
+        __atomic_add_fetch(&DroppedCount, 1, __ATOMIC_RELAXED);
+}
+
+unsigned long Logger::Dropped()
+{
+    return __atomic_load_n(&DroppedCount, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,294 @@
+#include "../inc/MaskList.hpp"
+#include "../inc/CaseMapping.hpp"
+
+// ? matches any character
+static bool SegmentAt(const char *text, const char *segment, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (segment[i] != '?' && segment[i] != text[i])
+            return false;
+    }
+    return true;
+}
+
+void MaskList::Glob::compile(const std::string &folded)
+{
+    pattern = folded;
+    segments.clear();
+    hasStar = folded.find('*') != std::string::npos;
+    anchoredStart = folded[0] != '*';
+    anchoredEnd = folded[folded.size() - 1] != '*';
+    size_t start = 0;
+    while (start < folded.size())
+    {
+        size_t star = folded.find('*', start);
+        if (star == std::string::npos)
+            star = folded.size();
+        if (star > start)
+            segments.push_back(std::make_pair(start, star - start));
+        start = star + 1;
+    }
+}
+
+// The first and last runs are pinned to the ends of the text unless a star
+// is there. The runs in between are placed as far left as they fit, which
+// leaves the most room for the ones after them, so no backtracking is needed.
+bool MaskList::Glob::matches(const std::string &text) const
+{
+    const char *p = pattern.data();
+    const char *t = text.data();
+    if (!hasStar)
+        return text.size() == pattern.size() && SegmentAt(t, p, pattern.size());
+    size_t begin = 0;
+    size_t end = text.size();
+    size_t first = 0;
+    size_t last = segments.size();
+    if (anchoredStart)
+    {
+        const std::pair<size_t, size_t> &run = segments[first++];
+        if (run.second > end || !SegmentAt(t, p + run.first, run.second))
+            return false;
+        begin = run.second;
+    }
+    if (anchoredEnd)
+    {
+        const std::pair<size_t, size_t> &run = segments[--last];
+        if (run.second > end - begin || !SegmentAt(t + end - run.second, p + run.first, run.second))
+            return false;
+        end -= run.second;
+    }
+    for (size_t i = first; i < last; i++)
+    {
+        const std::pair<size_t, size_t> &run = segments[i];
+        while (begin + run.second <= end && !SegmentAt(t + begin, p + run.first, run.second))
+            begin++;
+        if (begin + run.second > end)
+            return false;
+        begin += run.second;
+    }
+    return true;
+}
+
+// FNV-1a
+size_t MaskList::StringHash::operator()(const std::string &text) const
+{
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < text.size(); i++)
+        hash = (hash ^ static_cast<unsigned char>(text[i])) * 16777619u;
+    return hash;
+}
+
+MaskList::Trie::Trie() : nodes(1)
+{
+}
+
+void MaskList::Trie::clear()
+{
+    nodes.resize(1);
+    nodes[0].clear();
+    edges.clear();
+}
+
+std::vector<MaskList::Glob> &MaskList::Trie::at(const std::string &key)
+{
+    size_t node = 0;
+    for (size_t i = 0; i < key.size(); i++)
+    {
+        size_t edge = node * 256 + static_cast<unsigned char>(key[i]);
+        std::tr1::unordered_map<size_t, size_t>::iterator it = edges.find(edge);
+        if (it == edges.end())
+        {
+            it = edges.insert(std::make_pair(edge, nodes.size())).first;
+            nodes.push_back(std::vector<Glob>());
+        }
+        node = it->second;
+    }
+    return nodes[node];
+}
+
+std::vector<MaskList::Glob> *MaskList::Trie::find(const std::string &key)
+{
+    size_t node = 0;
+    for (size_t i = 0; i < key.size(); i++)
+    {
+        std::tr1::unordered_map<size_t, size_t>::iterator it = edges.find(node * 256 + static_cast<unsigned char>(key[i]));
+        if (it == edges.end())
+            return NULL;
+        node = it->second;
+    }
+    return &nodes[node];
+}
+
+bool MaskList::Trie::matches(const std::string &text, bool reversed) const
+{
+    size_t node = 0;
+    for (size_t i = 0; ; i++)
+    {
+        const std::vector<Glob> &globs = nodes[node];
+        for (std::vector<Glob>::const_iterator glob = globs.begin(); glob != globs.end(); glob++)
+        {
+            if (glob->matches(text))
+                return true;
+        }
+        if (i == text.size())
+            return false;
+        unsigned char c = reversed ? text[text.size() - 1 - i] : text[i];
+        std::tr1::unordered_map<size_t, size_t>::const_iterator it = edges.find(node * 256 + c);
+        if (it == edges.end())
+            return false;
+        node = it->second;
+    }
+}
+
+// A glob is filed under whichever of its literal prefix and suffix is
+// longer. Host bans like *!*@10.0.0.1 have no prefix but a long suffix,
+// nick bans the other way round. Only globs with neither, *!user@*, end up
+// at the root where every match has to try them.
+std::vector<MaskList::Glob> *MaskList::globsOf(const std::string &folded, bool create) const
+{
+    size_t prefix = folded.find_first_of("*?");
+    size_t suffix = folded.size() - folded.find_last_of("*?") - 1;
+    if (suffix > prefix)
+    {
+        std::string key(folded.rbegin(), folded.rbegin() + suffix);
+        return create ? &_index->suffixes.at(key) : _index->suffixes.find(key);
+    }
+    std::string key(folded, 0, prefix);
+    return create ? &_index->prefixes.at(key) : _index->prefixes.find(key);
+}
+
+MaskList::MaskList() : _indexed(0), _index(NULL)
+{
+}
+
+MaskList::~MaskList()
+{
+    delete _index;
+}
+
+// false for an empty or already indexed mask
+bool MaskList::insert(const std::string &folded) const
+{
+    if (folded.empty())
+        return false;
+    if (_index == NULL)
+        _index = new Index();
+    if (!_index->exact.insert(folded).second)
+        return false;
+    if (folded.find_first_of("*?") != std::string::npos)
+    {
+        std::vector<Glob> &globs = *globsOf(folded, true);
+        globs.push_back(Glob());
+        globs.back().compile(folded);
+    }
+    return true;
+}
+
+// Folds and indexes what load() appended, dropping duplicates
+void MaskList::index() const
+{
+    while (_indexed < _entries.size())
+    {
+        Entry &entry = _entries[_indexed];
+        FoldCaseInto(entry.mask, entry.folded);
+        if (insert(entry.folded))
+            _indexed++;
+        else
+            _entries.erase(_entries.begin() + _indexed);
+    }
+}
+
+bool MaskList::add(const std::string &mask)
+{
+    index();
+    std::string folded = FoldCase(mask);
+    if (!insert(folded))
+        return false;
+    Entry entry;
+    entry.mask = mask;
+    entry.folded = folded;
+    _entries.push_back(entry);
+    _indexed++;
+    return true;
+}
+
+void MaskList::load(const std::string &mask)
+{
+    _entries.push_back(Entry());
+    _entries.back().mask = mask;
+}
+
+bool MaskList::remove(const std::string &mask)
+{
+    index();
+    std::string folded = FoldCase(mask);
+    if (_index == NULL || _index->exact.erase(folded) == 0)
+        return false;
+    for (std::vector<Entry>::iterator it = _entries.begin(); it != _entries.end(); it++)
+    {
+        if (it->folded == folded)
+        {
+            _entries.erase(it);
+            _indexed--;
+            break;
+        }
+    }
+    if (folded.find_first_of("*?") == std::string::npos)
+        return true;
+    std::vector<Glob> &globs = *globsOf(folded, false);
+    for (std::vector<Glob>::iterator it = globs.begin(); it != globs.end(); it++)
+    {
+        if (it->pattern == folded)
+        {
+            globs.erase(it);
+            break;
+        }
+    }
+    return true;
+}
+
+bool MaskList::matches(const std::string &foldedHostmask) const
+{
+    if (_indexed < _entries.size())
+        index();
+    if (_entries.empty())
+        return false;
+    return _index->exact.count(foldedHostmask) || _index->prefixes.matches(foldedHostmask, false)
+           || _index->suffixes.matches(foldedHostmask, true);
+}
+
+// A pooled channel keeps the index for its next lists
+void MaskList::clear()
+{
+    _entries.clear();
+    _indexed = 0;
+    if (_index == NULL)
+        return;
+    _index->exact.clear();
+    _index->prefixes.clear();
+    _index->suffixes.clear();
+}
+
+size_t MaskList::size() const
+{
+    return _entries.size();
+}
+
+const std::string &MaskList::operator[](size_t pos) const
+{
+    return _entries[pos].mask;
+}
+
+std::string NormalizeMask(const std::string &mask)
+{
+    size_t bang = mask.find('!');
+    size_t at = mask.find('@', (bang == std::string::npos) ? 0 : bang);
+    if (bang == std::string::npos && at == std::string::npos)
+        return mask + "!*@*";
+    if (bang == std::string::npos)
+        return "*!" + mask;
+    if (at == std::string::npos)
+        return mask + "@*";
+    return mask;
+}
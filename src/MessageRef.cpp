@@ -0,0 +1,140 @@
+#include "../inc/MessageRef.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <new>
+#include <algorithm>
+#include <sys/socket.h>
+
+MessageRef::MessageRef() : _block(NULL), _offset(0)
+{
+}
+
+MessageRef::MessageRef(const std::string &line) : _offset(0)
+{
+    init(NULL, 0, line.data(), line.size());
+}
+
+MessageRef::MessageRef(const char *line, size_t length) : _offset(0)
+{
+    init(NULL, 0, line, length);
+}
+
+MessageRef::MessageRef(const char *prefix, size_t prefixLength, const std::string &line) : _offset(0)
+{
+    init(prefix, prefixLength, line.data(), line.size());
+}
+
+void MessageRef::init(const char *prefix, size_t prefixLength, const char *line, size_t length, bool terminate)
+{
+    // Header and payload share one allocation, +2 for the CRLF
+    _block = static_cast<Block *>(std::malloc(offsetof(Block, data) + prefixLength + length + 2));
+    if (_block == NULL)
+        throw std::bad_alloc();
+    _block->refs = 1;
+    _block->length = prefixLength + length + (terminate ? 2 : 0);
+    if (prefixLength)
+        std::memcpy(_block->data, prefix, prefixLength);
+    std::memcpy(_block->data + prefixLength, line, length);
+    _block->data[prefixLength + length] = '\r';
+    _block->data[prefixLength + length + 1] = '\n';
+}
+
+MessageRef::MessageRef(const MessageRef &other) : _block(other._block), _offset(other._offset)
+{
+    if (_block)
+        __atomic_add_fetch(&_block->refs, 1, __ATOMIC_RELAXED);
+}
+
+MessageRef &MessageRef::operator=(const MessageRef &other)
+{
+    if (other._block)
+        __atomic_add_fetch(&other._block->refs, 1, __ATOMIC_RELAXED);
+    release();
+    _block = other._block;
+    _offset = other._offset;
+    return *this;
+}
+
+MessageRef::~MessageRef()
+{
+    release();
+}
+
+void MessageRef::release()
+{
+    if (_block && __atomic_sub_fetch(&_block->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        std::free(_block);
+    _block = NULL;
+}
+
+const char *MessageRef::data() const
+{
+    return _block ? _block->data + _offset : "";
+}
+
+size_t MessageRef::size() const
+{
+    return _block ? _block->length - _offset : 0;
+}
+
+bool MessageRef::empty() const
+{
+    return _block == NULL;
+}
+
+size_t MessageRef::useCount() const
+{
+    return _block ? __atomic_load_n(&_block->refs, __ATOMIC_RELAXED) : 0;
+}
+
+MessageRef MessageRef::skip(size_t bytes) const
+{
+    MessageRef tail(*this);
+    tail._offset += bytes;
+    return tail;
+}
+
+MessageRef MessageRef::Fragment(const std::string &bytes)
+{
+    MessageRef fragment;
+    fragment.init(NULL, 0, bytes.data(), bytes.size(), false);
+    return fragment;
+}
+
+size_t GatherQueue(const std::deque<MessageRef> &queue, size_t offset, struct iovec *iov, size_t max)
+{
+    size_t count = std::min(queue.size(), max);
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t skip = (i == 0) ? offset : 0;
+        iov[i].iov_base = const_cast<char*>(queue[i].data() + skip);
+        iov[i].iov_len = queue[i].size() - skip;
+    }
+    return count;
+}
+
+ssize_t WriteQueue(int fd, const std::deque<MessageRef> &queue, size_t offset)
+{
+    struct iovec iov[MAX_WRITE_IOV];
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = iov;
+    message.msg_iovlen = GatherQueue(queue, offset, iov, MAX_WRITE_IOV);
+    return sendmsg(fd, &message, MSG_NOSIGNAL);
+}
+
+void ConsumeQueue(std::deque<MessageRef> &queue, size_t &offset, size_t sent)
+{
+    while (sent > 0)
+    {
+        size_t chunk = std::min(sent, queue.front().size() - offset);
+        offset += chunk;
+        sent -= chunk;
+        if (offset == queue.front().size())
+        {
+            queue.pop_front();
+            offset = 0;
+        }
+    }
+}
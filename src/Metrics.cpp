@@ -0,0 +1,81 @@
+#include "../inc/Metrics.hpp"
+#include <algorithm>
+
+Histogram::Histogram() : _count(0), _sum(0), _max(0)
+{
+    std::fill(_counts, _counts + BUCKETS, 0);
+}
+
+// Bucket group 0 holds the values below SUB_BUCKETS exactly, group g the
+// values whose highest bit is SUB_BUCKET_BITS + g - 1
+void Histogram::record(unsigned long long value)
+{
+    if (value >> MAX_BITS)
+        value = (1ULL << MAX_BITS) - 1;
+    int bucket;
+    if (value < static_cast<unsigned long long>(SUB_BUCKETS))
+        bucket = value;
+    else
+    {
+        int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+        bucket = (shift + 1) * SUB_BUCKETS + static_cast<int>(value >> shift) - SUB_BUCKETS;
+    }
+    _counts[bucket]++;
+    _count++;
+    _sum += value;
+    if (value > _max)
+        _max = value;
+}
+
+unsigned long long Histogram::UpperBound(int bucket)
+{
+    int group = bucket / SUB_BUCKETS;
+    unsigned long long sub = bucket % SUB_BUCKETS;
+    if (group == 0)
+        return sub;
+    return ((SUB_BUCKETS + sub + 1) << (group - 1)) - 1;
+}
+
+unsigned long Histogram::count() const
+{
+    return _count;
+}
+
+unsigned long long Histogram::sum() const
+{
+    return _sum;
+}
+
+unsigned long long Histogram::max() const
+{
+    return _max;
+}
+
+unsigned long long Histogram::percentile(double fraction) const
+{
+    if (_count == 0)
+        return 0;
+    unsigned long rank = static_cast<unsigned long>(_count * fraction);
+    unsigned long seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++)
+    {
+        seen += _counts[bucket];
+        if (seen > rank)
+            return std::min(UpperBound(bucket), _max);
+    }
+    return _max;
+}
+
+Metrics::Metrics() : startTime(time(NULL)), connectionsAccepted(0), connectionsClosed(0), bytesIn(0), bytesOut(0),
+                     droppedSends(0), messagesQueued(0), writeCalls(0), unknownCommands(0), floodThrottled(0), sendQueueExceeded(0)
+{
+    std::fill(commandCounts, commandCounts + CommandCount, 0);
+}
+
+// vDSO clock, cheap enough to take twice per command
+unsigned long long MonotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
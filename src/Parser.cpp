@@ -0,0 +1,91 @@
+#include "../inc/Parser.hpp"
+#include <cstring>
+
+StringView::StringView() : data(NULL), size(0)
+{
+}
+
+StringView::StringView(const char *data, size_t size) : data(data), size(size)
+{
+}
+
+bool StringView::empty() const
+{
+    return size == 0;
+}
+
+std::string StringView::str() const
+{
+    return std::string(data ? data : "", size);
+}
+
+// Reuses the capacity dest already has instead of building a new string
+void StringView::assignTo(std::string &dest) const
+{
+    dest.assign(data ? data : "", size);
+}
+
+// Returns the position of the next space, or end
+static const char *NextSpace(const char *pos, const char *end)
+{
+    const char *space = static_cast<const char *>(memchr(pos, ' ', end - pos));
+    return space ? space : end;
+}
+
+static const char *SkipSpaces(const char *pos, const char *end)
+{
+    while (pos < end && *pos == ' ')
+        pos++;
+    return pos;
+}
+
+// Splits a line (without its CRLF) into views, nothing is copied.
+// Returns false when there is no command.
+bool ParseMessage(const char *line, size_t length, IrcMessage &message)
+{
+    const char *pos = line;
+    const char *end = line + length;
+    const char *next;
+
+    message.tags = StringView();
+    message.prefix = StringView();
+    message.command = StringView();
+    message.paramCount = 0;
+    message.hasTrailing = false;
+
+    pos = SkipSpaces(pos, end);
+    if (pos < end && *pos == '@')
+    {
+        next = NextSpace(pos, end);
+        message.tags = StringView(pos + 1, next - pos - 1);
+        pos = SkipSpaces(next, end);
+    }
+    if (pos < end && *pos == ':')
+    {
+        next = NextSpace(pos, end);
+        message.prefix = StringView(pos + 1, next - pos - 1);
+        pos = SkipSpaces(next, end);
+    }
+    next = NextSpace(pos, end);
+    message.command = StringView(pos, next - pos);
+    if (message.command.empty())
+        return false;
+    pos = SkipSpaces(next, end);
+
+    while (pos < end)
+    {
+        // ':' starts the trailing parameter, so does running out of slots
+        if (*pos == ':' || message.paramCount == MAX_PARAMS - 1)
+        {
+            if (*pos == ':')
+                pos++;
+            message.params[message.paramCount++] = StringView(pos, end - pos);
+            message.hasTrailing = true;
+            break;
+        }
+        next = NextSpace(pos, end);
+        message.params[message.paramCount++] = StringView(pos, next - pos);
+        pos = SkipSpaces(next, end);
+    }
+    return true;
+}
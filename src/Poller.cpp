@@ -0,0 +1,195 @@
+#include "../inc/Poller.hpp"
+#include <cerrno>
+#include <unistd.h>
+
+#ifdef USE_SELECT
+# include <sys/socket.h>
+#endif
+
+#ifdef USE_SELECT
+
+Poller::Poller() : _maxFd(-1), _count(0)
+{
+    FD_ZERO(&_readSet);
+    FD_ZERO(&_writeSet);
+}
+
+Poller::~Poller()
+{
+}
+
+bool Poller::add(int fd, int events)
+{
+    if (fd < 0 || fd >= FD_SETSIZE)
+        return false;
+    if (static_cast<size_t>(fd) >= _interest.size())
+        _interest.resize(fd + 1, -1);
+    if (_interest[fd] != -1)
+        return false;
+    _interest[fd] = 0;
+    _count++;
+    if (fd > _maxFd)
+        _maxFd = fd;
+    return modify(fd, events);
+}
+
+bool Poller::modify(int fd, int events)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= _interest.size() || _interest[fd] == -1)
+        return false;
+    _interest[fd] = events;
+    // select() has no hang-up condition, a socket without PollIn is still
+    // watched for reading so wait() can peek for a close or a reset
+    FD_SET(fd, &_readSet);
+    if (events & PollOut)
+        FD_SET(fd, &_writeSet);
+    else
+        FD_CLR(fd, &_writeSet);
+    return true;
+}
+
+void Poller::remove(int fd)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= _interest.size() || _interest[fd] == -1)
+        return;
+    FD_CLR(fd, &_readSet);
+    FD_CLR(fd, &_writeSet);
+    _interest[fd] = -1;
+    _count--;
+    while (_maxFd >= 0 && _interest[_maxFd] == -1)
+        _maxFd--;
+}
+
+int Poller::wait(std::vector<PollEvent> &events, int timeoutMs)
+{
+    events.clear();
+    fd_set readSet = _readSet;
+    fd_set writeSet = _writeSet;
+    struct timeval tv;
+    struct timeval *timeout = NULL;
+    if (timeoutMs >= 0)
+    {
+        tv.tv_sec = timeoutMs / 1000;
+        tv.tv_usec = (timeoutMs % 1000) * 1000;
+        timeout = &tv;
+    }
+    int ready = select(_maxFd + 1, &readSet, &writeSet, NULL, timeout);
+    if (ready == -1)
+        return (errno == EINTR) ? 0 : -1;
+    for (int fd = 0; fd <= _maxFd && static_cast<int>(events.size()) < ready; fd++)
+    {
+        PollEvent ev;
+        ev.fd = fd;
+        ev.events = 0;
+        if (FD_ISSET(fd, &readSet) && (_interest[fd] & PollIn))
+            ev.events |= PollIn;
+        else if (FD_ISSET(fd, &readSet))
+        {
+            // Unread input hides a close behind it, so the socket is left
+            // alone until the next modify() instead of waking every round
+            char byte;
+            ssize_t peeked = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+            if (peeked == 0 || (peeked == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                ev.events |= PollErr;
+            else if (peeked > 0)
+                FD_CLR(fd, &_readSet);
+        }
+        if (FD_ISSET(fd, &writeSet))
+            ev.events |= PollOut;
+        if (ev.events)
+            events.push_back(ev);
+    }
+    return events.size();
+}
+
+const char *Poller::backend()
+{
+    return "select";
+}
+
+#else
+
+static int ToEpoll(int events)
+{
+    int flags = 0;
+    if (events & PollIn)
+        flags |= EPOLLIN;
+    if (events & PollOut)
+        flags |= EPOLLOUT;
+    return flags;
+}
+
+Poller::Poller() : _count(0)
+{
+    _epollFd = epoll_create1(EPOLL_CLOEXEC);
+    _ready.resize(256);
+}
+
+Poller::~Poller()
+{
+    if (_epollFd != -1)
+        close(_epollFd);
+}
+
+bool Poller::add(int fd, int events)
+{
+    struct epoll_event ev;
+    ev.events = ToEpoll(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev) == -1)
+        return false;
+    _count++;
+    return true;
+}
+
+bool Poller::modify(int fd, int events)
+{
+    struct epoll_event ev;
+    ev.events = ToEpoll(events);
+    ev.data.fd = fd;
+    return epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &ev) != -1;
+}
+
+void Poller::remove(int fd)
+{
+    struct epoll_event ev;
+    if (epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, &ev) != -1)
+        _count--;
+}
+
+int Poller::wait(std::vector<PollEvent> &events, int timeoutMs)
+{
+    events.clear();
+    int ready = epoll_wait(_epollFd, &_ready[0], _ready.size(), timeoutMs);
+    if (ready == -1)
+        return (errno == EINTR) ? 0 : -1;
+    for (int i = 0; i < ready; i++)
+    {
+        PollEvent ev;
+        ev.fd = _ready[i].data.fd;
+        ev.events = 0;
+        if (_ready[i].events & EPOLLIN)
+            ev.events |= PollIn;
+        if (_ready[i].events & EPOLLOUT)
+            ev.events |= PollOut;
+        if (_ready[i].events & (EPOLLERR | EPOLLHUP))
+            ev.events |= PollErr;
+        events.push_back(ev);
+    }
+    // A full batch means more sockets are likely waiting, grow for the next round
+    if (static_cast<size_t>(ready) == _ready.size() && _ready.size() < 65536)
+        _ready.resize(_ready.size() * 2);
+    return ready;
+}
+
+const char *Poller::backend()
+{
+    return "epoll";
+}
+
+#endif
+
+size_t Poller::size() const
+{
+    return _count;
+}
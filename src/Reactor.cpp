@@ -0,0 +1,491 @@
+#include "../inc/Reactor.hpp"
+#include "../inc/Logger.hpp"
+#include "../inc/Utils.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sched.h>
+
+const size_t READ_SIZE = 4096;
+const size_t COMMAND_QUEUE_SIZE = 65536;
+
+Wakeup::Wakeup() : _pending(0)
+{
+    _fds[0] = -1;
+    _fds[1] = -1;
+}
+
+Wakeup::~Wakeup()
+{
+    if (_fds[0] != -1)
+        close(_fds[0]);
+    if (_fds[1] != -1)
+        close(_fds[1]);
+}
+
+bool Wakeup::open()
+{
+    if (pipe(_fds) == -1)
+        return false;
+    fcntl(_fds[0], F_SETFL, fcntl(_fds[0], F_GETFL, 0) | O_NONBLOCK);
+    fcntl(_fds[1], F_SETFL, fcntl(_fds[1], F_GETFL, 0) | O_NONBLOCK);
+    return true;
+}
+
+int Wakeup::fd() const
+{
+    return _fds[0];
+}
+
+// Both sides swap the flag, so a notify() that finds it already set is
+// ordered before the clear() that will reset it, and the owner sees
+// whatever was queued before that notify()
+void Wakeup::notify()
+{
+    if (__atomic_exchange_n(&_pending, 1, __ATOMIC_SEQ_CST) == 0)
+    {
+        ssize_t written = write(_fds[1], "", 1);
+        (void)written;
+    }
+}
+
+void Wakeup::clear()
+{
+    char drain[64];
+    while (read(_fds[0], drain, sizeof(drain)) > 0)
+        ;
+    __atomic_exchange_n(&_pending, 0, __ATOMIC_SEQ_CST);
+}
+
+ReactorShard::ReactorShard(int index, MpscQueue<ShardEvent> &events, Wakeup &serverWakeup)
+    : _index(index), _listenFd(-1), _commands(COMMAND_QUEUE_SIZE), _events(events), _serverWakeup(serverWakeup),
+      _started(false), _running(0), _posted(false), _bytesOut(0), _droppedSends(0), _queuedBytes(0),
+      _writeCalls(0)
+{
+}
+
+ReactorShard::~ReactorShard()
+{
+    Stop();
+    if (_listenFd != -1)
+        close(_listenFd);
+    for (size_t fd = 0; fd < _connections.size(); fd++)
+    {
+        if (_connections[fd] && _connections[fd]->open)
+            close(fd);
+        delete _connections[fd];
+    }
+    // Hang-ups the server thread never heard of still hold their socket
+    for (std::deque<ShardEvent>::iterator it = _backlog.begin(); it != _backlog.end(); it++)
+    {
+        if (it->type == ShardClosed)
+            close(it->fd);
+        std::free(it->data);
+    }
+}
+
+// Every shard listens on the same port, the kernel spreads the incoming
+// connections over the listeners
+bool ReactorShard::Start(int port)
+{
+    if (!_wakeup.open() || !_poller.add(_wakeup.fd(), PollIn))
+    {
+        LOG_ERROR("Reactor %d: failed to create its wakeup pipe: %s", _index, strerror(errno));
+        return false;
+    }
+    _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (_listenFd == -1)
+    {
+        LOG_ERROR("Reactor %d: failed to create socket: %s", _index, strerror(errno));
+        return false;
+    }
+    int reuse = 1;
+    if (setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1
+#ifdef SO_REUSEPORT
+        || setsockopt(_listenFd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == -1
+#endif
+        )
+    {
+        LOG_ERROR("Reactor %d: failed to set socket options: %s", _index, strerror(errno));
+        return false;
+    }
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = INADDR_ANY;
+    if (bind(_listenFd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == -1
+        || listen(_listenFd, SOMAXCONN) == -1)
+    {
+        LOG_ERROR("Reactor %d: failed to listen on port %d: %s", _index, port, strerror(errno));
+        return false;
+    }
+    fcntl(_listenFd, F_SETFL, fcntl(_listenFd, F_GETFL, 0) | O_NONBLOCK);
+    if (!_poller.add(_listenFd, PollIn))
+    {
+        LOG_ERROR("Reactor %d: failed to register socket with %s", _index, Poller::backend());
+        return false;
+    }
+    _running = 1;
+    if (pthread_create(&_thread, NULL, Main, this) != 0)
+    {
+        LOG_ERROR("Reactor %d: failed to start its thread", _index);
+        return false;
+    }
+    _started = true;
+    return true;
+}
+
+void ReactorShard::Stop()
+{
+    if (!_started)
+        return;
+    __atomic_store_n(&_running, 0, __ATOMIC_RELEASE);
+    _wakeup.notify();
+    pthread_join(_thread, NULL);
+    _started = false;
+}
+
+void *ReactorShard::Main(void *shard)
+{
+    static_cast<ReactorShard*>(shard)->Loop();
+    return NULL;
+}
+
+void ReactorShard::Loop()
+{
+    std::vector<PollEvent> events;
+    while (__atomic_load_n(&_running, __ATOMIC_ACQUIRE))
+    {
+        // While the server thread is behind nothing more is read, the
+        // sockets wait in the kernel and the commands keep flowing
+        EmitBacklog();
+        if (!_backlog.empty())
+        {
+            _wakeup.clear();
+            RunCommands();
+            _serverWakeup.notify();
+            usleep(1000);
+            continue;
+        }
+        if (_poller.wait(events, -1) == -1)
+        {
+            if (errno != EINTR)
+                LOG_ERROR("Reactor %d: failed to wait for socket activity: %s", _index, strerror(errno));
+            continue;
+        }
+        bool emitted = false;
+        for (std::vector<PollEvent>::iterator event = events.begin(); event != events.end(); event++)
+        {
+            if (event->fd == _wakeup.fd())
+                continue;
+            emitted = true;
+            if (event->fd == _listenFd)
+                Accept();
+            else
+                Read(event->fd, event->events);
+        }
+        _wakeup.clear();
+        RunCommands();
+        if (emitted)
+            _serverWakeup.notify();
+    }
+}
+
+void ReactorShard::Accept()
+{
+    while (true)
+    {
+        ShardEvent event;
+        std::memset(&event, 0, sizeof(event));
+        socklen_t addressLength = sizeof(event.address);
+        int fd = accept(_listenFd, reinterpret_cast<struct sockaddr *>(&event.address), &addressLength);
+        if (fd == -1)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                LOG_WARNING("Reactor %d: failed to accept client connection: %s", _index, strerror(errno));
+            return;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        SetNoDelay(fd);
+        if (!_poller.add(fd, PollIn))
+        {
+            LOG_WARNING("Reactor %d: failed to register client socket %d", _index, fd);
+            close(fd);
+            continue;
+        }
+        if (static_cast<size_t>(fd) >= _connections.size())
+            _connections.resize(fd + 1, NULL);
+        if (_connections[fd] == NULL)
+        {
+            _connections[fd] = new Connection();
+            _connections[fd]->generation = 0;
+        }
+        Connection &connection = *_connections[fd];
+        connection.generation++;
+        connection.open = true;
+        connection.paused = false;
+        connection.exceeded = false;
+        connection.flushPending = false;
+        connection.pollEvents = PollIn;
+        connection.sendOffset = 0;
+        connection.sendQueueBytes = 0;
+
+        event.type = ShardAccepted;
+        event.shard = _index;
+        event.fd = fd;
+        event.generation = connection.generation;
+        Emit(event);
+    }
+}
+
+// Hands every chunk to the server thread as it comes, the lines are framed
+// there. A paused connection is only read to notice a hang-up.
+void ReactorShard::Read(int fd, int events)
+{
+    Connection *connection = _connections[fd];
+    if (events & PollOut)
+        Flush(fd);
+    if (!(events & (PollIn | PollErr)) || (connection->paused && !(events & PollErr)))
+        return;
+    char buffer[READ_SIZE];
+    while (true)
+    {
+        ssize_t bytesRead = recv(fd, buffer, sizeof(buffer), 0);
+        if (bytesRead > 0)
+        {
+            ShardEvent event;
+            std::memset(&event, 0, sizeof(event));
+            event.type = ShardData;
+            event.shard = _index;
+            event.fd = fd;
+            event.generation = connection->generation;
+            event.data = static_cast<char*>(std::malloc(bytesRead));
+            if (event.data == NULL)
+                return Close(fd, true);
+            std::memcpy(event.data, buffer, bytesRead);
+            event.size = bytesRead;
+            Emit(event);
+            continue;
+        }
+        if (bytesRead == -1 && errno == EINTR)
+            continue;
+        if (bytesRead == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (bytesRead == -1)
+            LOG_WARNING("Reactor %d: failed to read from client socket %d: %s", _index, fd, strerror(errno));
+        return Close(fd, true);
+    }
+}
+
+void ReactorShard::Flush(int fd)
+{
+    Connection &connection = *_connections[fd];
+    while (!connection.sendQueue.empty())
+    {
+        ssize_t sent = WriteQueue(fd, connection.sendQueue, connection.sendOffset);
+        __atomic_add_fetch(&_writeCalls, 1, __ATOMIC_RELAXED);
+        if (sent > 0)
+        {
+            __atomic_add_fetch(&_bytesOut, sent, __ATOMIC_RELAXED);
+            __atomic_sub_fetch(&_queuedBytes, sent, __ATOMIC_RELAXED);
+            connection.sendQueueBytes -= sent;
+            ConsumeQueue(connection.sendQueue, connection.sendOffset, sent);
+            continue;
+        }
+        if (sent == -1 && errno == EINTR)
+            continue;
+        if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        // The peer is gone, reading the socket reports the hang-up
+        __atomic_add_fetch(&_droppedSends, connection.sendQueue.size(), __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&_queuedBytes, connection.sendQueueBytes, __ATOMIC_RELAXED);
+        connection.sendQueue.clear();
+        connection.sendOffset = 0;
+        connection.sendQueueBytes = 0;
+    }
+    UpdateInterest(fd);
+}
+
+void ReactorShard::UpdateInterest(int fd)
+{
+    Connection &connection = *_connections[fd];
+    int events = connection.paused ? 0 : PollIn;
+    if (!connection.sendQueue.empty())
+        events |= PollOut;
+    if (events != connection.pollEvents && _poller.modify(fd, events))
+        connection.pollEvents = events;
+}
+
+// A hang-up is reported to the server thread, and the socket stays open
+// until the report is queued: the server thread must hear of it before it
+// can hear of a new connection reusing the number
+void ReactorShard::Close(int fd, bool report)
+{
+    Connection &connection = *_connections[fd];
+    _poller.remove(fd);
+    connection.open = false;
+    connection.flushPending = false;
+    __atomic_add_fetch(&_droppedSends, connection.sendQueue.size(), __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&_queuedBytes, connection.sendQueueBytes, __ATOMIC_RELAXED);
+    connection.sendQueue.clear();
+    connection.sendOffset = 0;
+    connection.sendQueueBytes = 0;
+    if (!report)
+    {
+        close(fd);
+        return;
+    }
+    ShardEvent event;
+    std::memset(&event, 0, sizeof(event));
+    event.type = ShardClosed;
+    event.shard = _index;
+    event.fd = fd;
+    event.generation = connection.generation;
+    Emit(event);
+}
+
+ReactorShard::Connection *ReactorShard::find(int fd, unsigned int generation)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= _connections.size() || _connections[fd] == NULL)
+        return NULL;
+    Connection *connection = _connections[fd];
+    if (!connection->open || connection->generation != generation)
+        return NULL;
+    return connection;
+}
+
+// Commands for connections that are gone are dropped, the server thread
+// hears of the hang-up through its queue. The lines of a batch are written
+// once it is done, one gathering write per connection.
+void ReactorShard::RunCommands()
+{
+    ShardCommand command;
+    while (_commands.pop(command))
+    {
+        Connection *connection = find(command.fd, command.generation);
+        if (connection == NULL)
+        {
+            if (command.type == ShardSend)
+                __atomic_add_fetch(&_droppedSends, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (command.type == ShardSend)
+        {
+            connection->sendQueue.push_back(command.message);
+            connection->sendQueueBytes += command.message.size();
+            __atomic_add_fetch(&_queuedBytes, command.message.size(), __ATOMIC_RELAXED);
+            if (!connection->flushPending)
+            {
+                connection->flushPending = true;
+                _pendingFlush.push_back(command.fd);
+            }
+            if (command.sendQueueLimit && connection->sendQueueBytes > command.sendQueueLimit)
+                Flush(command.fd);
+            if (command.sendQueueLimit && connection->sendQueueBytes > command.sendQueueLimit && !connection->exceeded)
+            {
+                __atomic_add_fetch(&_droppedSends, connection->sendQueue.size(), __ATOMIC_RELAXED);
+                __atomic_sub_fetch(&_queuedBytes, connection->sendQueueBytes, __ATOMIC_RELAXED);
+                connection->sendQueue.clear();
+                connection->sendOffset = 0;
+                connection->sendQueueBytes = 0;
+                connection->exceeded = true;
+                UpdateInterest(command.fd);
+                ShardEvent event;
+                std::memset(&event, 0, sizeof(event));
+                event.type = ShardSendQueueExceeded;
+                event.shard = _index;
+                event.fd = command.fd;
+                event.generation = command.generation;
+                Emit(event);
+                _serverWakeup.notify();
+            }
+        }
+        else if (command.type == ShardPause || command.type == ShardResume)
+        {
+            connection->paused = (command.type == ShardPause);
+            UpdateInterest(command.fd);
+        }
+        else if (command.type == ShardClose)
+        {
+            // Last chance for the ERROR line and the like
+            Flush(command.fd);
+            Close(command.fd, false);
+        }
+    }
+    for (size_t i = 0; i < _pendingFlush.size(); i++)
+    {
+        Connection &connection = *_connections[_pendingFlush[i]];
+        if (!connection.flushPending)
+            continue;
+        connection.flushPending = false;
+        Flush(_pendingFlush[i]);
+    }
+    _pendingFlush.clear();
+}
+
+// Events keep their order: once one waits in the backlog, every later one
+// queues behind it
+void ReactorShard::Emit(const ShardEvent &event)
+{
+    if (_backlog.empty() && _events.push(event))
+        return Emitted(event);
+    _backlog.push_back(event);
+}
+
+void ReactorShard::Emitted(const ShardEvent &event)
+{
+    if (event.type == ShardClosed)
+        close(event.fd);
+}
+
+void ReactorShard::EmitBacklog()
+{
+    while (!_backlog.empty() && _events.push(_backlog.front()))
+    {
+        Emitted(_backlog.front());
+        _backlog.pop_front();
+    }
+}
+
+// A full command queue means the shard is behind, the server thread waits
+// for it rather than dropping output
+void ReactorShard::Post(const ShardCommand &command)
+{
+    while (!_commands.push(command))
+    {
+        _wakeup.notify();
+        sched_yield();
+    }
+    _posted = true;
+}
+
+void ReactorShard::Wake()
+{
+    if (_posted)
+        _wakeup.notify();
+    _posted = false;
+}
+
+unsigned long long ReactorShard::bytesOut() const
+{
+    return __atomic_load_n(&_bytesOut, __ATOMIC_RELAXED);
+}
+
+unsigned long ReactorShard::droppedSends() const
+{
+    return __atomic_load_n(&_droppedSends, __ATOMIC_RELAXED);
+}
+
+unsigned long long ReactorShard::queuedBytes() const
+{
+    return __atomic_load_n(&_queuedBytes, __ATOMIC_RELAXED);
+}
+
+unsigned long ReactorShard::writeCalls() const
+{
+    return __atomic_load_n(&_writeCalls, __ATOMIC_RELAXED);
+}
@@ -1,33 +1,17 @@
 #include "../inc/Server.hpp"
+#include <sstream>
+#include <cstdio>
 
-const std::map<std::string, void (Server::*)(class Client &, std::vector<std::string>)> CmdMap()
-{
-    std::map<std::string, void (Server::*)(class Client &, std::vector<std::string>)> cmds;
-    cmds["CAP"] = &Server::Cap;
-    cmds["PASS"] = &Server::Pass;
-    cmds["NICK"] = &Server::Nick;
-    cmds["USER"] = &Server::User;
-    cmds["PING"] = &Server::Ping;
-    cmds["QUIT"] = &Server::Quit;
-    cmds["JOIN"] = &Server::Join;
-    cmds["PART"] = &Server::Part;
-    cmds["TOPIC"] = &Server::Topic;
-    cmds["NAMES"] = &Server::Names;
-    cmds["INVITE"] = &Server::Invite;
-    cmds["MODE"] = &Server::Mode;
-    cmds["KICK"] = &Server::Kick;
-    cmds["NOTICE"] = &Server::Notice;
-    cmds["PRIVMSG"] = &Server::PrivMsg;
-    cmds["LIST"] = &Server::List;
-    return cmds;
-}
-
-Server::Server(const std::string &Port, const std::string &Password) : cmds(CmdMap())
+Server::Server(const std::string &Port, const std::string &Password, const Config &config) : _serverSocketFd(-1), _config(config), _metricsSocketFd(-1),
+                                                                                                 _nowMs(MonotonicNs() / 1000000), _timers(_nowMs), _ioMode(IoPoller),
+                                                                                                 _shardEvents(NULL), _uring(NULL), _multishotAccept(true), _multishotRecv(true),
+                                                                                                 _fanoutMark(0), _lastMsgid(RealtimeMs() * 1000), _lastBatch(0),
+                                                                                                 _snapshotting(false), _snapshotChannels(0), _snapshotSize(0)
 {
     if (Port.empty())
     {
         _port = 6667;
-        std::cout << "Port is not given so your server initialized with default port 6667\n";
+        LOG_INFO("Port is not given so your server initialized with default port 6667");
     }
     else
     {
@@ -38,42 +22,65 @@ Server::Server(const std::string &Port, const std::string &Password) : cmds(CmdM
     if (Password.empty())
     {
         _password = "1234";
-        std::cout << "Password is not given so your server initialized with default password 1234\n";
+        LOG_INFO("Password is not given so your server initialized with default password 1234");
     }
     else
         _password = Password;
 
+    std::ostringstream chanLimit, historyLength;
+    if (_config.maxChannelsPerUser)
+        chanLimit << _config.maxChannelsPerUser;
+    historyLength << _config.historyLength;
+    _tokens = TOKENS(chanLimit.str(), std::string(CaseMappingName(_config.caseMapping)), historyLength.str());
+    SetCaseMapping(_config.caseMapping);
+
     _channels = std::map<std::string, class Channel*>();
-    _clients =  std::vector<class Client*>();
+    RestoreState();
 }
 
 Server::~Server() 
 {
+    // The pools destroy the clients and channels themselves, the reactor
+    // threads close the sockets they own
+    StopShards();
     for(std::vector<Client*>::iterator it = _clients.begin(); it != _clients.end(); it++)
     {
-        delete *it;
+        if (*it && _ioMode != IoShards)
+            close((*it)->getSocketFd());
     }
+#ifdef USE_URING
+    delete _uring;
+#endif
     _clients.clear();
-    for(std::map<std::string, class Channel*>::iterator it = _channels.begin(); it != _channels.end(); it++)
+    _channels.clear();
+    if (_metricsSocketFd != -1)
     {
-        delete it->second;
+        close(_metricsSocketFd);
+        unlink(_config.metricsSocket.c_str());
     }
-    _channels.clear();
 }
 
-Server Server::Listen()
+Server &Server::Listen()
 {
+    if (_config.reactorThreads)
+    {
+        StartShards();
+        ListenMetrics();
+        LOG_INFO("IRC server listening on port %d (%u I/O offload threads, %s)", _port, static_cast<unsigned int>(_shards.size()), Poller::backend());
+        return *this;
+    }
+
     _serverSocketFd = socket(AF_INET, SOCK_STREAM, 0);
     if (_serverSocketFd == -1)
     {
-        std::cerr << "Failed to create socket.\n";
+        LOG_ERROR("Failed to create socket: %s", strerror(errno));
         exit(EXIT_FAILURE);
     }
 
     int reuse = 1;
     if (setsockopt(_serverSocketFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1)
     {
-        std::cerr << "Failed to set socket options.\n";
+        LOG_ERROR("Failed to set socket options: %s", strerror(errno));
         close(_serverSocketFd);
         exit(EXIT_FAILURE);
     }
@@ -84,188 +91,627 @@ Server Server::Listen()
     serverAddress.sin_addr.s_addr = INADDR_ANY;
     if (bind(_serverSocketFd, reinterpret_cast<struct sockaddr *>(&serverAddress), sizeof(serverAddress)) == -1)
     {
-        std::cerr << "Failed to bind socket to port " << _port << "\n";
+        LOG_ERROR("Failed to bind socket to port %d: %s", _port, strerror(errno));
         close(_serverSocketFd);
         exit(EXIT_FAILURE);
     }
     _serverAddress = serverAddress;
     // Listen for incoming connections
-    if (listen(_serverSocketFd, MAX_CLIENTS) == -1)
+    if (listen(_serverSocketFd, SOMAXCONN) == -1)
     {
-        std::cerr << "Failed to listen on socket.\n";
+        LOG_ERROR("Failed to listen on socket: %s", strerror(errno));
         close(_serverSocketFd);
         exit(EXIT_FAILURE);
     }
 
-    std::cout << "IRC server listening on port " << _port << "...\n";
+    // Accept() drains the backlog until EAGAIN, so the listener must not block
+    fcntl(_serverSocketFd, F_SETFL, fcntl(_serverSocketFd, F_GETFL, 0) | O_NONBLOCK);
+#ifdef USE_URING
+    if (StartUring())
+    {
+        ListenMetrics();
+        LOG_INFO("IRC server listening on port %d (io_uring, %s)", _port, _uring->bufferRing() ? "buffer ring" : "provided buffers");
+        return *this;
+    }
+#endif
+    if (!_poller.add(_serverSocketFd, PollIn))
+    {
+        LOG_ERROR("Failed to register socket with %s", Poller::backend());
+        close(_serverSocketFd);
+        exit(EXIT_FAILURE);
+    }
+
+    ListenMetrics();
+
+    LOG_INFO("IRC server listening on port %d (%s)", _port, Poller::backend());
     return *this;
 }
 
 void Server::Run()
 {
+#ifdef USE_URING
+    if (_ioMode == IoUring)
+        return RunUring();
+#endif
+    if (_ioMode == IoShards)
+        return RunShards();
+    std::vector<PollEvent> events;
     while (true)
     {
-        fd_set readSet;
-        FD_ZERO(&readSet);
-
-        int maxSocket = _serverSocketFd;
+        // Only the sockets with pending activity are reported, the timeout wakes the timer wheel
+        int ready = _poller.wait(events, WaitTimeoutMs());
+        _nowMs = MonotonicNs() / 1000000;
+        if (ready == -1)
+        {
+            LOG_ERROR("Failed to wait for socket activity: %s", strerror(errno));
+            continue;
+        }
+        for (std::vector<PollEvent>::iterator event = events.begin(); event != events.end(); event++)
+        {
+            if (event->fd == _serverSocketFd)
+                Accept();
+            else if (event->fd == _metricsSocketFd)
+                AcceptMetrics();
+            else
+                Serve(*event);
+        }
+        RunTimers();
+        DropSlowClients();
+        WriteSnapshotSlice();
+        _journal.flush();
+        FlushPending();
+    }
+}
 
-        // Add server socket to the set
-        FD_SET(_serverSocketFd, &readSet);
+void Server::Accept()
+{
+    while (true)
+    {
+        sockaddr_in clientAddress;
+        socklen_t clientAddressLength = sizeof(clientAddress);
 
-        // Add client sockets to the set
-        for (std::vector<Client*>::iterator client = _clients.begin(); client != _clients.end(); client++)
+        // Accept a new connection
+        int clientSocket = accept(_serverSocketFd, reinterpret_cast<struct sockaddr *>(&clientAddress), &clientAddressLength);
+        if (clientSocket == -1)
         {
-            FD_SET((*client)->getSocketFd(), &readSet);
-            maxSocket = std::max(maxSocket, (*client)->getSocketFd());
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                LOG_WARNING("Failed to accept client connection: %s", strerror(errno));
+            return;
         }
 
-        // Use select to wait for activity on sockets
-        if (select(maxSocket + 1, &readSet, NULL, NULL, NULL) == -1)
+        // Set client socket to non-blocking mode
+        int flags = fcntl(clientSocket, F_GETFL, 0);
+        fcntl(clientSocket, F_SETFL, flags | O_NONBLOCK);
+        SetNoDelay(clientSocket);
+
+        if (AddClient(clientSocket, clientAddress) == NULL)
+            close(clientSocket);
+    }
+}
+
+// Takes over a connected socket, also the entry point for fake clients
+Client *Server::AddClient(int clientSocket, const sockaddr_in &clientAddress)
+{
+    // Registered once, stays registered until RemoveClient. The reactor
+    // threads and io_uring watch their sockets themselves.
+    if (_ioMode == IoPoller && !_poller.add(clientSocket, PollIn))
+    {
+        LOG_WARNING("Failed to register client socket %d", clientSocket);
+        return NULL;
+    }
+
+    // Handle the client connection
+    LOG_INFO("New client connected. Socket descriptor: %d", clientSocket);
+
+    Client* newish = _clientPool.acquire();
+    newish->reset(clientSocket);
+    newish->addHostname(clientAddress);
+    newish->_lastActivity = _nowMs;
+    newish->_floodTokens = _config.floodBurst * 1000ULL;
+    newish->_floodRefilledAt = _nowMs;
+    unsigned int deadline = _config.registrationTimeout ? _config.registrationTimeout : _config.pingInterval;
+    if (deadline)
+        _timers.schedule(newish->_timer, _nowMs + deadline * 1000ULL);
+    if (static_cast<size_t>(clientSocket) >= _clients.size())
+        _clients.resize(clientSocket + 1, NULL);
+    _clients[clientSocket] = newish;
+    _metrics.connectionsAccepted++;
+    return newish;
+}
+
+void Server::RemoveClient(Client *client)
+{
+    int clientSocket = client->getSocketFd();
+    // Last chance for queued replies (QUIT, errors) to leave
+    flushClient(*client);
+    std::tr1::unordered_map<std::string, Client*>::iterator nick = _nicks.find(client->_foldedNick);
+    if (!client->_nick.empty() && nick != _nicks.end() && nick->second == client)
+        _nicks.erase(nick);
+    // Expired timers of this client may still be waiting in _expired
+    _timers.cancel(client->_timer);
+    _timers.cancel(client->_floodTimer);
+    client->_timer.owner = NULL;
+    client->_floodTimer.owner = NULL;
+    _clients[clientSocket] = NULL;
+    _metrics.connectionsClosed++;
+    if (_ioMode == IoShards)
+        PostToShard(*client, ShardClose);
+#ifdef USE_URING
+    if (_ioMode == IoUring)
+    {
+        // The socket stays open and the client allocated until the kernel
+        // is done with both
+        client->_closing = true;
+        if (client->_recvArmed)
+            UringCancelRecv(*client);
+        if (client->_hangupArmed)
+            UringCancelHangup(*client);
+        return UringFinish(*client);
+    }
+#endif
+    if (_ioMode == IoPoller)
+    {
+        _poller.remove(clientSocket);
+        close(clientSocket);
+    }
+    client->_flushPending = false; // its entry in _pendingFlush is skipped
+    _clientPool.release(client);
+}
+
+// Drops a client the server gave up on, only called outside of Serve()
+void Server::Disconnect(Client &client, const std::string &reason)
+{
+    LOG_INFO("Dropping client on socket %d: %s", client.getSocketFd(), reason.c_str());
+    sendServerToClient(client, CLOSING_LINK(client._hostname, reason));
+    if (client._status == UsernameRegistered)
+        Quit(client, std::vector<std::string>(1, reason));
+    client._online = false;
+    RemoveClient(&client);
+}
+
+void Server::RunTimers()
+{
+    _expired.clear();
+    _timers.advance(_nowMs, _expired);
+    for (std::vector<Timer*>::iterator it = _expired.begin(); it != _expired.end(); it++)
+    {
+        if (*it == &_snapshotTimer)
         {
-            std::cerr << "Failed to select socket activity.\n";
+            WriteSnapshot();
             continue;
         }
+        Client *client = static_cast<Client*>((*it)->owner);
+        if (client == NULL)
+            continue;
+        if (*it == &client->_floodTimer)
+            Resume(*client);
+        else
+            ClientTimeout(*client);
+    }
+}
 
-        // Check if the server socket has activity (new client connection)
-        if (FD_ISSET(_serverSocketFd, &readSet))
-        {
-            sockaddr_in clientAddress;
-            socklen_t clientAddressLength = sizeof(clientAddress);
-
-            // Accept a new connection
-            int clientSocket = accept(_serverSocketFd, reinterpret_cast<struct sockaddr *>(&clientAddress), &clientAddressLength);
-            if (clientSocket == -1)
-            {
-                std::cerr << "Failed to accept client connection.\n";
-                continue;
-            }
+// Does not block while a snapshot still has slices to serialize
+int Server::WaitTimeoutMs() const
+{
+    return _snapshotting ? 0 : _timers.timeoutMs(_nowMs);
+}
 
-            // Handle the client connection
-            std::cout << "New client connected. Socket descriptor: " << clientSocket << "\n";
+// A client has one timer. Until it registers that is the registration
+// deadline, afterwards the keepalive: reading a line only stamps
+// _lastActivity, and when the timer fires it is pushed back to a full
+// ping_interval after that stamp. Only a client silent for that long gets a
+// PING, and only one that stays silent for ping_timeout more is dropped.
+void Server::ClientTimeout(Client &client)
+{
+    if (client._status != UsernameRegistered)
+    {
+        if (_config.registrationTimeout)
+            return Disconnect(client, "Registration timeout");
+        return _timers.schedule(client._timer, _nowMs + _config.pingInterval * 1000ULL);
+    }
+    if (_config.pingInterval == 0)
+        return;
+    if (client._pingSentAt && client._lastActivity >= client._pingSentAt)
+        client._pingSentAt = 0;
+    if (_nowMs - client._lastActivity < _config.pingInterval * 1000ULL)
+        return _timers.schedule(client._timer, client._lastActivity + _config.pingInterval * 1000ULL);
+    if (client._pingSentAt && _config.pingTimeout)
+        return Disconnect(client, "Ping timeout");
+    sendServerToClient(client, PING(std::string("ircserv")));
+    client._pingSentAt = _nowMs;
+    unsigned int wait = _config.pingTimeout ? _config.pingTimeout : _config.pingInterval;
+    _timers.schedule(client._timer, _nowMs + wait * 1000ULL);
+}
 
-            // Set client socket to non-blocking mode
-            int flags = fcntl(clientSocket, F_GETFL, 0);
-            fcntl(clientSocket, F_SETFL, flags | O_NONBLOCK);
+void Server::Serve(const PollEvent &event)
+{
+    if (event.fd < 0 || static_cast<size_t>(event.fd) >= _clients.size() || _clients[event.fd] == NULL)
+        return;
+    Client *client = _clients[event.fd];
+    int clientSocket = event.fd;
+
+    if (event.events & PollOut)
+        flushClient(*client);
+    if (!(event.events & (PollIn | PollErr)))
+        return;
 
-            // Add client to the vector
-            Client* newish = new Client(clientSocket);
-            newish->addHostname(_serverAddress);
-            _clients.push_back(newish);
+    // Drain the socket, whatever follows the last line stays in _input for the next read.
+    // Unregistered clients are in no channel, a hang-up needs no QUIT handling.
+    // A throttled client is only read to notice a hang-up.
+    while (client->_online && (!client->_throttled || (event.events & PollErr)))
+    {
+        ssize_t bytesRead = client->_input.readFrom(clientSocket, BUFFER_SIZE);
+        if (bytesRead == 0)
+        {
+            LOG_INFO("Client disconnected. Socket descriptor: %d", clientSocket);
+            if (client->_status == UsernameRegistered)
+                Quit(*client, std::vector<std::string>());
+            client->_online = false;
+        }
+        else if (bytesRead == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            LOG_WARNING("Failed to read from client socket %d: %s", clientSocket, strerror(errno));
+            if (client->_status == UsernameRegistered)
+                Quit(*client, std::vector<std::string>());
+            client->_online = false;
+        }
+        else
+        {
+            _metrics.bytesIn += bytesRead;
+            client->_lastActivity = _nowMs;
+            ProcessInput(client);
         }
-        // Check client sockets for activity
-        Serve(readSet);
     }
+    if (client->_online == false)
+        RemoveClient(client);
 }
 
-void Server::Serve(fd_set readSet)
+// Runs every complete line in the client's input buffer
+void Server::ProcessInput(Client *client)
 {
-    std::vector<Client*>::iterator client = _clients.begin();
-    while (client != _clients.end())
+    Buffer &input = client->_input;
+    const char *eol;
+    while (client->_online && (eol = input.findLine()) != NULL)
     {
-        int clientSocket = (*client)->getSocketFd();
-        if ((*client)->_online == false)
+        const char *line = input.peek();
+        size_t lineLength = eol - line;
+        size_t consumed = lineLength + 1;
+        // The end of a line already answered with ERR_INPUTTOOLONG, it is
+        // not a command of its own
+        if (client->_discardLine)
         {
-            close(clientSocket);
-            Client* dead = *client;
-            client = _clients.erase(client);
-            delete dead;
+            client->_discardLine = false;
+            input.consume(consumed);
             continue;
         }
-        if (FD_ISSET(clientSocket, &readSet))
+        if (lineLength > 0 && line[lineLength - 1] == '\r')
+            lineLength--;
+        IrcMessage message;
+        if (consumed > MAX_LINE_LENGTH)
+            sendServerToClient(*client, ERR_INPUTTOOLONG(client->_nick));
+        else if (ParseMessage(line, lineLength, message))
         {
-            char buffer[BUFFER_SIZE];
-            memset(buffer, 0, sizeof(buffer));
-
-            // Read data from the client socket
-            int bytesRead = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-            if (bytesRead == 0)
-            {
-                std::cout << "Client disconnected. Socket descriptor: " << clientSocket << "\n";
-                Quit(**client, std::vector<std::string>());
-                continue;
-            }
-            if (bytesRead == -1)
-            {
-                // Connection closed by the client
-                // Handle recv error or client disconnection
-/*                 if (errno == ECONNRESET || errno == ENETRESET || errno == ECONNABORTED)
-                    std::cout << "Client disconnected. Socket descriptor: " << clientSocket << "\n";
-                else */
-                std::cerr << "Failed to read from client socket.\n";
-                Quit(**client, std::vector<std::string>());
-                continue;
-            }
-            //  Process received data and handle IRC commands
-            std::string message(buffer, bytesRead);
-            std::cout << "Received data from client: " << message << "\n";
-            //  Check if the message starts with a command character
-            ProcessCommand(message, *client);
-/*          else if (message[0] == '!')
-            ProcessBot(message, *client); */
+            // Unpaid lines stay in the buffer until the bucket refills
+            CommandId command = LookupCommand(message.command.data, message.command.size);
+            if (!TakeTokens(*client, command))
+                return Throttle(*client, command);
+            LOG_DEBUG("line from %d: %.*s", client->getSocketFd(), static_cast<int>(lineLength), line);
+            ProcessCommand(message, client, command);
         }
-        ++client;
+        input.consume(consumed);
+    }
+    // A line that will never fit is dropped instead of growing the buffer
+    // forever, up to its newline even if that comes with a later read
+    if (client->_online && client->_discardLine)
+        input.clear();
+    else if (client->_online && input.readable() >= MAX_LINE_LENGTH)
+    {
+        sendServerToClient(*client, ERR_INPUTTOOLONG(client->_nick));
+        client->_discardLine = true;
+        input.clear();
     }
 }
 
-void Server::ProcessCommand(std::string &message, Client *client)
+// The views of message point into the client's input buffer, they are only
+// copied into the strings of _params, which keep their capacity between lines.
+// command is what the flood check already looked up for message.
+void Server::ProcessCommand(const IrcMessage &message, Client *client, CommandId command)
 {
-    std::vector<std::string> str = split(message,"\r\n");
-    for(std::vector<std::string>::iterator it = str.begin(); it != str.end()-1; ++it)
+    if (command == CommandCount)
     {
-        std::cout <<"line: " << *it << "\n";
-        size_t spacePos = (it->find(' ')  != std::string::npos) ? it->find(' ') : it->size();
-        std::string command = it->substr(0, spacePos);
-        std::cout <<"cmd: " << command << "\n";
-        spacePos = (spacePos == it->size()) ? spacePos -1 : spacePos;
-        if (cmds.find(command) != cmds.end())
-            (this->*cmds.at(command))(*client, split(it->substr(spacePos + 1), " "));
+        _metrics.unknownCommands++;
+        return;
     }
-    //sendServerToClient(*client, message); //rawMessage
+    unsigned long long start = MonotonicNs();
+    _metrics.commandCounts[command]++;
+    _params.resize(message.paramCount);
+    for (size_t i = 0; i < message.paramCount; i++)
+        message.params[i].assignTo(_params[i]);
+    (this->*CommandTable[command].handler)(*client, _params);
+    _metrics.commandLatency[command].record(MonotonicNs() - start);
 }
 
-void Server::sendServerToClient(Client &reciever, const std::string &message)
+// Appends to the client's send queue. Nothing is written right away: the
+// replies of a whole loop iteration (JOIN with its topic and names, a LIST)
+// leave together in FlushPending(), what the socket does not take is kept
+// and flushed once the poller reports the socket writable again. Only the
+// reference is queued, the bytes are shared with every other recipient.
+void Server::queueMessage(Client &reciever, const MessageRef &message)
 {
-    std::string formattedMessage = message + "\r\n";
-    if (send(reciever.getSocketFd(), formattedMessage.c_str(), formattedMessage.length(), 0) == -1)
+    if (!reciever._online || reciever._sendQueueExceeded)
+    {
+        _metrics.droppedSends++;
+        return;
+    }
+    _metrics.messagesQueued++;
+    // The reactor thread keeps the queue and enforces the limit
+    if (_ioMode == IoShards)
+        return PostToShard(reciever, ShardSend, message);
+    reciever._sendQueue.push_back(message);
+    reciever._sendQueueBytes += message.size();
+    scheduleFlush(reciever);
+
+    // A queue over the limit gets to drain into the socket first. A client
+    // that does not read cannot be dropped in the middle of a fan-out, its
+    // queue is freed now and the client later.
+    unsigned int limit = SendQueueLimit(reciever);
+    if (limit && reciever._sendQueueBytes > limit && _ioMode == IoPoller)
+        flushClient(reciever);
+    if (limit && reciever._sendQueueBytes > limit)
     {
-        std::cerr << "Failed to send chat message between "
-                  << "ircserv"
-                  << " -> " << reciever._nick << "\n";
+        DropSendQueue(reciever);
+        reciever._sendQueueExceeded = true;
+        _slowClients.push_back(reciever.getSocketFd());
     }
 }
 
-void Server::sendServerToChannel(const std::string &ChannelName, const std::string &message)
+unsigned int Server::SendQueueLimit(const Client &client) const
 {
-    std::string formattedMessage = message + "\r\n";
-    std::vector<Client*>::iterator client = _channels.at(ChannelName)->getMembers().begin();
-    std::vector<Client*>::iterator end = _channels.at(ChannelName)->getMembers().end();
-    for (; client != end; client++)
+    if (client._isOper)
+        return _config.sendQueueOper;
+    if (client._status == UsernameRegistered)
+        return _config.sendQueue;
+    return _config.sendQueueUnregistered;
+}
+
+// Runs once per loop iteration, outside of any handler. A client that hung
+// up in the meantime is gone from _clients or its socket belongs to a new
+// client, which is not flagged.
+void Server::DropSlowClients()
+{
+    for (size_t i = 0; i < _slowClients.size(); i++)
     {
-        if (send((*client)->getSocketFd(), formattedMessage.c_str(), formattedMessage.length(), 0) == -1)
+        Client *client = _clients[_slowClients[i]];
+        if (client == NULL || !client->_sendQueueExceeded)
+            continue;
+        LOG_WARNING("Max SendQ exceeded for %s on socket %d", client->_nick.c_str(), _slowClients[i]);
+        _metrics.sendQueueExceeded++;
+        client->_sendQueueExceeded = false;
+        Disconnect(*client, "Max SendQ exceeded");
+    }
+    _slowClients.clear();
+}
+
+void Server::scheduleFlush(Client &client)
+{
+    if (client._flushPending || client._sendQueue.empty())
+        return;
+    client._flushPending = true;
+    _pendingFlush.push_back(&client);
+}
+
+// Runs once per loop iteration, before the next wait
+void Server::FlushPending()
+{
+    for (size_t i = 0; i < _pendingFlush.size(); i++)
+    {
+        Client &client = *_pendingFlush[i];
+        if (!client._flushPending)
+            continue;
+        client._flushPending = false;
+#ifdef USE_URING
+        if (_ioMode == IoUring)
         {
-            std::cerr << "Failed to send chat message between " << ChannelName << " -> " << (*client)->_nick << "\n";
+            UringFlush(client);
             continue;
         }
+#endif
+        flushClient(client);
+    }
+    _pendingFlush.clear();
+}
+
+// Up to MAX_WRITE_IOV queued lines per system call
+void Server::flushClient(Client &client)
+{
+#ifdef USE_URING
+    // Submitted with the next wait, together with everything queued until then
+    if (_ioMode == IoUring)
+        return scheduleFlush(client);
+#endif
+    while (!client._sendQueue.empty())
+    {
+        ssize_t sent = WriteQueue(client.getSocketFd(), client._sendQueue, client._sendOffset);
+        _metrics.writeCalls++;
+        if (sent > 0)
+        {
+            _metrics.bytesOut += sent;
+            client._sendQueueBytes -= sent;
+            ConsumeQueue(client._sendQueue, client._sendOffset, sent);
+            continue;
+        }
+        if (sent == -1 && errno == EINTR)
+            continue;
+        if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        // The peer is gone, the poller reports the socket and Serve() cleans up
+        LOG_WARNING("Failed to send queued data to %s: %s", client._nick.c_str(), strerror(errno));
+        DropSendQueue(client);
+    }
+    updateInterest(client);
+}
+
+// Drops what still waits in the send queue. Lines handed to io_uring stay
+// until the kernel is done with them.
+void Server::DropSendQueue(Client &client)
+{
+    size_t keep = client._sendInFlight;
+    _metrics.droppedSends += client._sendQueue.size() - keep;
+    client._sendQueue.erase(client._sendQueue.begin() + keep, client._sendQueue.end());
+    if (keep == 0)
+        client._sendOffset = 0;
+    client._sendQueueBytes = 0;
+    for (size_t i = 0; i < keep; i++)
+        client._sendQueueBytes += client._sendQueue[i].size();
+    client._sendQueueBytes -= client._sendOffset;
+}
+
+// Asks for writability only while something is waiting in the send queue,
+// and for input only while the client has tokens to spend
+void Server::updateInterest(Client &client)
+{
+    int events = client._throttled ? 0 : PollIn;
+    if (_ioMode != IoPoller)
+    {
+        if (events == client._pollEvents)
+            return;
+        client._pollEvents = events;
+        if (_ioMode == IoShards)
+            return PostToShard(client, events ? ShardResume : ShardPause);
+#ifdef USE_URING
+        // A throttled client is only watched for a hang-up
+        if (!events)
+        {
+            if (client._recvArmed)
+                UringCancelRecv(client);
+            if (!client._hangupArmed)
+                UringArmHangup(client);
+        }
+        else if (client._online)
+        {
+            if (client._hangupArmed)
+                UringCancelHangup(client);
+            if (!client._recvArmed)
+                UringArmRecv(client);
+        }
+#endif
+        return;
     }
+    if (!client._sendQueue.empty())
+        events |= PollOut;
+    if (events != client._pollEvents && _poller.modify(client.getSocketFd(), events))
+        client._pollEvents = events;
+}
+
+void Server::sendServerToClient(Client &reciever, const std::string &message)
+{
+    queueMessage(reciever, MessageRef(message));
 }
 
-void Server::sendClientToChannel(Client &sender, const std::string &ChannelName, const std::string &message)
+// The line is serialised once, fan-out only copies the reference
+void Server::sendServerToChannel(Channel &chan, const std::string &message)
 {
-    if (sender._channel.empty())
-        return ;
-    std::string formattedMessage = message + "\r\n";
-    std::vector<Client*>::iterator client = _channels.at(ChannelName)->getMembers().begin();
-    std::vector<Client*>::iterator end = _channels.at(ChannelName)->getMembers().end();
+    MessageRef formattedMessage(message);
+    IndexedSet<Client*>::iterator client = chan.getMembers().begin();
+    IndexedSet<Client*>::iterator end = chan.getMembers().end();
     for (; client != end; client++)
+        queueMessage(**client, formattedMessage);
+}
+
+// NICK and QUIT go to everyone sharing a channel with the sender, once each
+// however many channels they share. A peer is marked with the fan-out it
+// got the line from, so no set of recipients is built.
+void Server::sendClientToCommonPeers(Client &sender, const std::string &message)
+{
+    MessageRef formattedMessage(message);
+    _fanoutMark++;
+    sender._fanoutMark = _fanoutMark;
+    for (std::map<std::string, Channel*>::iterator chan = sender._channel.begin(); chan != sender._channel.end(); chan++)
     {
-        if ((*client)->getSocketFd() != sender.getSocketFd())
+        IndexedSet<Client*>::iterator client = chan->second->getMembers().begin();
+        IndexedSet<Client*>::iterator end = chan->second->getMembers().end();
+        for (; client != end; client++)
         {
-            if (send((*client)->getSocketFd(), formattedMessage.c_str(), formattedMessage.length(), 0) == -1)
-            {
-                std::cerr << "Failed to send chat message between " << sender._nick << " -> " << (*client)->_nick << "\n";
+            if ((*client)->_fanoutMark == _fanoutMark)
                 continue;
-            }
+            (*client)->_fanoutMark = _fanoutMark;
+            queueMessage(**client, formattedMessage);
         }
     }
 }
+
+// JOIN, PART and channel PRIVMSG: the line is serialised once with its time
+// and msgid tags and kept in the channel history. Members that did not
+// negotiate message-tags get the same block past the tags.
+void Server::sendChannelEvent(Channel &chan, Client *skip, const std::string &message)
+{
+    HistoryEntry entry;
+    entry.msgid = ++_lastMsgid;
+    entry.timeMs = RealtimeMs();
+    char stamp[32];
+    char tags[96];
+    FormatServerTime(entry.timeMs, stamp, sizeof(stamp));
+    entry.tagLength = snprintf(tags, sizeof(tags), "@time=%s;msgid=%llu ", stamp, entry.msgid);
+    entry.line = MessageRef(tags, entry.tagLength, message);
+    chan._history.record(entry.line, entry.tagLength, entry.msgid, entry.timeMs);
+    IndexedSet<Client*>::iterator client = chan.getMembers().begin();
+    IndexedSet<Client*>::iterator end = chan.getMembers().end();
+    for (; client != end; client++)
+    {
+        if (*client != skip)
+            sendHistoryEntry(**client, entry);
+    }
+}
+
+void Server::sendHistoryEntry(Client &reciever, const HistoryEntry &entry)
+{
+    queueMessage(reciever, reciever._messageTags ? entry.line : entry.line.skip(entry.tagLength));
+}
+
+// Token bucket in thousandths of a token, refilled from the loop clock when
+// a line is paid for. A command dearer than the whole bucket runs once the
+// bucket is full, otherwise it could never run at all.
+bool Server::TakeTokens(Client &client, CommandId command)
+{
+    if (_config.floodRate == 0)
+        return true;
+    unsigned long long capacity = _config.floodBurst * 1000ULL;
+    unsigned long long cost = (command == CommandCount ? 1 : _config.commandCosts[command]) * 1000ULL;
+    client._floodTokens = std::min(capacity, client._floodTokens + (_nowMs - client._floodRefilledAt) * _config.floodRate);
+    client._floodRefilledAt = _nowMs;
+    if (cost > capacity && client._floodTokens == capacity)
+        cost = capacity;
+    if (client._floodTokens < cost)
+        return false;
+    client._floodTokens -= cost;
+    return true;
+}
+
+// Stops reading the socket until the next line can be paid for. What the
+// client keeps sending piles up in the kernel buffers and, once those are
+// full, TCP makes the client wait.
+void Server::Throttle(Client &client, CommandId command)
+{
+    unsigned long long cost = (command == CommandCount ? 1 : _config.commandCosts[command]) * 1000ULL;
+    cost = std::min(cost, _config.floodBurst * 1000ULL);
+    unsigned long long wait = (cost - client._floodTokens + _config.floodRate - 1) / _config.floodRate;
+    if (!client._throttled)
+        _metrics.floodThrottled++;
+    client._throttled = true;
+    updateInterest(client);
+    _timers.schedule(client._floodTimer, _nowMs + wait);
+}
+
+// Runs the deferred lines, which may throttle the client again
+void Server::Resume(Client &client)
+{
+    client._throttled = false;
+    updateInterest(client);
+    ProcessInput(&client);
+    if (!client._online)
+        RemoveClient(&client);
+}
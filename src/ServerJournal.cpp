@@ -0,0 +1,314 @@
+#include "../inc/Server.hpp"
+
+// The snapshot is one file that the restore maps and walks front to back:
+// a header, then one record per channel in _channels order. A record is its
+// fixed part followed by the name, topic, key and operator nick, then the
+// b, e and I masks as a u16 length and the bytes each, padded to 4 bytes.
+static const char SNAPSHOT_MAGIC[8] = {'I', 'R', 'C', 'S', 'N', 'A', 'P', '1'};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    unsigned int channels;
+    unsigned int reserved;
+    unsigned long long size; // of the whole file, a short one is rejected
+};
+
+struct SnapshotChannel
+{
+    unsigned int size; // of the whole record
+    unsigned int mode;
+    unsigned int limit;
+    unsigned short nameLength;
+    unsigned short topicLength;
+    unsigned short keyLength;
+    unsigned short operatorLength;
+    unsigned int maskCounts[3];
+};
+
+static const char MASK_MODES[3] = {'b', 'e', 'I'};
+
+// Channels serialized per loop iteration while a snapshot is taken, about
+// a millisecond of work without optimization
+static const unsigned int SNAPSHOT_SLICE = 1000;
+
+static unsigned short PutString(std::string &out, const std::string &text, const Channel &chan, const char *field)
+{
+    size_t length = text.size();
+    if (length > 0xffff)
+    {
+        LOG_WARNING("Snapshot of %s: %s of %lu bytes cut to 65535", chan._name.c_str(), field, static_cast<unsigned long>(length));
+        length = 0xffff;
+    }
+    out.append(text, 0, length);
+    return length;
+}
+
+static bool GetMask(const char *&cursor, const char *end, std::string &mask)
+{
+    unsigned short length;
+    if (end - cursor < 2)
+        return false;
+    memcpy(&length, cursor, 2);
+    if (end - cursor - 2 < length)
+        return false;
+    mask.assign(cursor + 2, length);
+    cursor += 2 + length;
+    return true;
+}
+
+// The snapshot first, then the journal written since it. Refuses to start
+// on a damaged snapshot rather than overwrite it with an empty state later.
+void Server::RestoreState()
+{
+    const std::string &base = _config.stateFile;
+    if (base.empty())
+        return;
+    unsigned long long start = MonotonicNs();
+    std::vector<JournalRecord> records;
+    if (!RestoreSnapshot(Journal::SnapshotPath(base)) || !Journal::Replay(base, records))
+        exit(EXIT_FAILURE);
+    for (std::vector<JournalRecord>::iterator it = records.begin(); it != records.end(); it++)
+        ApplyJournalRecord(*it);
+    LOG_INFO("Restored %lu channels from %s in %.1f ms, %lu journal records", static_cast<unsigned long>(_channels.size()),
+             base.c_str(), (MonotonicNs() - start) / 1e6, static_cast<unsigned long>(records.size()));
+
+    if (!_journal.open(base))
+        exit(EXIT_FAILURE);
+    if (_config.snapshotInterval)
+        _timers.schedule(_snapshotTimer, _nowMs + _config.snapshotInterval * 1000ULL);
+}
+
+bool Server::RestoreSnapshot(const std::string &path)
+{
+    MappedFile file;
+    if (!file.map(path))
+    {
+        LOG_ERROR("Failed to read %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    if (file.size() == 0)
+        return true;
+    const char *cursor = file.data();
+    const char *end = cursor + file.size();
+    SnapshotHeader header;
+    if (file.size() >= sizeof(header))
+        memcpy(&header, cursor, sizeof(header));
+    if (file.size() < sizeof(header) || memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+        || header.size != file.size())
+    {
+        LOG_ERROR("%s is not a complete snapshot", path.c_str());
+        return false;
+    }
+    cursor += sizeof(header);
+
+    std::string name;
+    std::string mask;
+    for (unsigned int i = 0; i < header.channels; i++)
+    {
+        SnapshotChannel record;
+        if (static_cast<size_t>(end - cursor) < sizeof(record))
+            break;
+        memcpy(&record, cursor, sizeof(record));
+        const char *recordEnd = cursor + record.size;
+        const char *field = cursor + sizeof(record);
+        size_t strings = static_cast<size_t>(record.nameLength) + record.topicLength + record.keyLength + record.operatorLength;
+        if (record.size < sizeof(record) || record.size > static_cast<size_t>(end - cursor)
+            || strings > static_cast<size_t>(recordEnd - field) || record.nameLength == 0)
+            break;
+        name.assign(field, record.nameLength);
+        field += record.nameLength;
+        Channel *chan = RestoreChannel(name);
+        chan->_topic.assign(field, record.topicLength);
+        field += record.topicLength;
+        chan->setKey(std::string(field, record.keyLength));
+        field += record.keyLength;
+        chan->_operatorNick.assign(field, record.operatorLength);
+        field += record.operatorLength;
+        chan->_mode = record.mode;
+        chan->_clientLimit = record.limit;
+        // Fewer masks than counted, or more than padding after them, is
+        // a damaged record
+        bool masks = true;
+        for (int list = 0; list < 3 && masks; list++)
+        {
+            for (unsigned int j = 0; j < record.maskCounts[list] && masks; j++)
+            {
+                masks = GetMask(field, recordEnd, mask);
+                if (masks)
+                    chan->getMaskList(MASK_MODES[list])->load(mask);
+            }
+        }
+        if (!masks || recordEnd - field >= 4)
+            break;
+        cursor = recordEnd;
+    }
+    if (cursor != end)
+    {
+        LOG_ERROR("%s is corrupt at byte %lu", path.c_str(), static_cast<unsigned long>(cursor - file.data()));
+        return false;
+    }
+    return true;
+}
+
+// Also reopens a channel the journal creates again over the snapshot
+Channel *Server::RestoreChannel(const std::string &ChannelName)
+{
+    Channel *chan = findChannel(ChannelName);
+    if (chan)
+    {
+        chan->reset(ChannelName);
+        return chan;
+    }
+    chan = _channelPool.acquire();
+    chan->reset(ChannelName);
+    chan->_history.reset(_config.historyLength);
+    // The snapshot is in map order, the hint makes each insert O(1)
+    _channels.insert(_channels.end(), std::make_pair(chan->_foldedName, chan));
+    return chan;
+}
+
+void Server::ApplyJournalRecord(const JournalRecord &record)
+{
+    Channel *chan = (record.type == RecordCreate) ? RestoreChannel(record.channel) : findChannel(record.channel);
+    if (chan == NULL)
+        return;
+    switch (record.type)
+    {
+    case RecordCreate:
+    case RecordOperator:
+        chan->_operatorNick = record.text;
+        break;
+    case RecordDrop:
+        _channels.erase(chan->_foldedName);
+        _channelPool.release(chan);
+        break;
+    case RecordTopic:
+        chan->_topic = record.text;
+        break;
+    case RecordModes:
+        chan->_mode = record.a;
+        chan->_clientLimit = record.b;
+        chan->setKey(record.text);
+        break;
+    case RecordMask:
+        if (MaskList *list = chan->getMaskList(record.a))
+        {
+            if (record.b)
+                list->add(record.text);
+            else
+                list->remove(record.text);
+        }
+        break;
+    }
+}
+
+static void PutChannel(std::string &out, Channel &chan)
+{
+    size_t start = out.size();
+    out.append(sizeof(SnapshotChannel), '\0');
+    SnapshotChannel record;
+    record.mode = chan._mode;
+    record.limit = chan._clientLimit;
+    record.nameLength = PutString(out, chan._name, chan, "name");
+    record.topicLength = PutString(out, chan._topic, chan, "topic");
+    record.keyLength = PutString(out, chan.getKey(), chan, "key");
+    record.operatorLength = PutString(out, chan._operatorNick, chan, "operator");
+    for (int list = 0; list < 3; list++)
+    {
+        const MaskList &masks = *chan.getMaskList(MASK_MODES[list]);
+        record.maskCounts[list] = masks.size();
+        for (size_t i = 0; i < masks.size(); i++)
+        {
+            size_t lengthAt = out.size();
+            out.append(2, '\0');
+            unsigned short length = PutString(out, masks[i], chan, "mask");
+            memcpy(&out[lengthAt], &length, 2);
+        }
+    }
+    out.append((4 - out.size() % 4) % 4, '\0');
+    record.size = out.size() - start;
+    memcpy(&out[start], &record, sizeof(record));
+}
+
+// Starts a snapshot, WriteSnapshotSlice() serializes it over the next loop
+// iterations. Skipped while nothing changed since the last one.
+void Server::WriteSnapshot()
+{
+    if (_config.snapshotInterval)
+        _timers.schedule(_snapshotTimer, _nowMs + _config.snapshotInterval * 1000ULL);
+    if (_snapshotting || _journal.records() == 0)
+        return;
+    _journal.beginSnapshot();
+    _snapshotting = true;
+    _snapshotCursor.clear();
+    _snapshotChannels = 0;
+    // The header is written over this placeholder once the size is known
+    _snapshotSize = sizeof(SnapshotHeader);
+    _journal.snapshotData(new std::string(sizeof(SnapshotHeader), '\0'));
+}
+
+// Channels are taken in map order from the last one written, so channels
+// created or dropped in between do not disturb the walk. A channel changed
+// after its slice is fixed up by the journal records appended since
+// WriteSnapshot(), which are replayed over the snapshot.
+void Server::WriteSnapshotSlice()
+{
+    if (!_snapshotting)
+        return;
+    std::map<std::string, Channel*>::iterator it = _snapshotCursor.empty() ? _channels.begin() : _channels.upper_bound(_snapshotCursor);
+    std::string *slice = new std::string();
+    slice->reserve(SNAPSHOT_SLICE * (sizeof(SnapshotChannel) + 64));
+    const std::string *last = NULL;
+    for (unsigned int count = 0; it != _channels.end() && count < SNAPSHOT_SLICE; it++, count++)
+    {
+        PutChannel(*slice, *it->second);
+        last = &it->first;
+        _snapshotChannels++;
+    }
+    if (last)
+        _snapshotCursor = *last;
+    _snapshotSize += slice->size();
+    _journal.snapshotData(slice);
+    if (it != _channels.end())
+        return;
+
+    SnapshotHeader header;
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.channels = _snapshotChannels;
+    header.reserved = 0;
+    header.size = _snapshotSize;
+    _journal.endSnapshot(new std::string(reinterpret_cast<const char *>(&header), sizeof(header)));
+    _snapshotting = false;
+    LOG_INFO("Snapshot of %u channels, %llu bytes, handed to the writer", _snapshotChannels, _snapshotSize);
+}
+
+void Server::JournalCreate(Channel &chan)
+{
+    _journal.append(RecordCreate, 0, 0, chan._name, chan._operatorNick);
+}
+
+void Server::JournalDrop(Channel &chan)
+{
+    _journal.append(RecordDrop, 0, 0, chan._name, "");
+}
+
+void Server::JournalTopic(Channel &chan)
+{
+    _journal.append(RecordTopic, 0, 0, chan._name, chan._topic);
+}
+
+void Server::JournalModes(Channel &chan)
+{
+    _journal.append(RecordModes, chan._mode, chan._clientLimit, chan._name, chan.getKey());
+}
+
+void Server::JournalMask(Channel &chan, char mode, bool added, const std::string &Mask)
+{
+    _journal.append(RecordMask, mode, added, chan._name, Mask);
+}
+
+void Server::JournalOperator(Channel &chan)
+{
+    _journal.append(RecordOperator, 0, 0, chan._name, chan._operatorNick);
+}
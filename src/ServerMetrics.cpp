@@ -0,0 +1,176 @@
+#include "../inc/Server.hpp"
+#include <sstream>
+#include <sys/un.h>
+#include <sys/stat.h>
+
+// The metrics socket answers every connection with one scrape in the
+// Prometheus text format and closes it, there is no request to read.
+void Server::ListenMetrics()
+{
+    const std::string &path = _config.metricsSocket;
+    if (path.empty())
+        return;
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        LOG_WARNING("metrics_socket path is too long, metrics socket disabled");
+        return;
+    }
+    path.copy(address.sun_path, path.size());
+
+    // A socket left behind by an earlier run, anything else is not ours to remove
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+        unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == -1
+        || listen(fd, 16) == -1)
+    {
+        LOG_WARNING("Failed to open metrics socket %s: %s", path.c_str(), strerror(errno));
+        if (fd != -1)
+            close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    if (!_poller.add(fd, PollIn))
+    {
+        LOG_WARNING("Failed to register metrics socket with %s", Poller::backend());
+        close(fd);
+        unlink(path.c_str());
+        return;
+    }
+    _metricsSocketFd = fd;
+    LOG_INFO("Metrics available on %s", path.c_str());
+}
+
+// The scrape fits in the socket buffer, a reader that does not take it all
+// at once gets a truncated one instead of stalling the event loop
+void Server::AcceptMetrics()
+{
+    std::string scrape;
+    while (true)
+    {
+        int fd = accept(_metricsSocketFd, NULL, NULL);
+        if (fd == -1)
+            return;
+        if (scrape.empty())
+            scrape = FormatMetrics();
+        send(fd, scrape.data(), scrape.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        close(fd);
+    }
+}
+
+SendQueueTotals Server::CountSendQueues() const
+{
+    SendQueueTotals totals = {0, 0, 0, 0, 0, 0};
+    for (std::vector<Client*>::const_iterator it = _clients.begin(); it != _clients.end(); it++)
+    {
+        if (*it == NULL)
+            continue;
+        unsigned long long memory = (*it)->memoryUsage();
+        totals.memory += memory;
+        totals.maxMemory = std::max(totals.maxMemory, memory);
+        if ((*it)->_sendQueue.empty())
+            continue;
+        totals.clients++;
+        totals.messages += (*it)->_sendQueue.size();
+        totals.bytes += (*it)->_sendQueueBytes;
+        totals.maxBytes = std::max<unsigned long long>(totals.maxBytes, (*it)->_sendQueueBytes);
+    }
+    // With reactor threads the queues live there, only their total is known
+    for (std::vector<ReactorShard*>::const_iterator it = _shards.begin(); it != _shards.end(); it++)
+        totals.bytes += (*it)->queuedBytes();
+    return totals;
+}
+
+unsigned long long Server::BytesOut() const
+{
+    unsigned long long bytes = _metrics.bytesOut;
+    for (std::vector<ReactorShard*>::const_iterator it = _shards.begin(); it != _shards.end(); it++)
+        bytes += (*it)->bytesOut();
+    return bytes;
+}
+
+unsigned long Server::DroppedSends() const
+{
+    unsigned long dropped = _metrics.droppedSends;
+    for (std::vector<ReactorShard*>::const_iterator it = _shards.begin(); it != _shards.end(); it++)
+        dropped += (*it)->droppedSends();
+    return dropped;
+}
+
+unsigned long Server::WriteCalls() const
+{
+    unsigned long calls = _metrics.writeCalls;
+    for (std::vector<ReactorShard*>::const_iterator it = _shards.begin(); it != _shards.end(); it++)
+        calls += (*it)->writeCalls();
+    return calls;
+}
+
+// How well replies are batched: 1000 when every line costs a system call
+double Server::WriteCallsPer1k() const
+{
+    if (_metrics.messagesQueued == 0)
+        return 0;
+    return WriteCalls() * 1000.0 / _metrics.messagesQueued;
+}
+
+template <typename T>
+static void Write(std::ostringstream &out, const char *name, const char *type, const char *help, T value)
+{
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " " << type << "\n"
+        << name << " " << value << "\n";
+}
+
+std::string Server::FormatMetrics() const
+{
+    std::ostringstream out;
+    SendQueueTotals queues = CountSendQueues();
+
+    Write(out, "ircserv_uptime_seconds", "gauge", "Seconds since the server started.", time(NULL) - _metrics.startTime);
+    Write(out, "ircserv_connections_accepted_total", "counter", "Client connections accepted.", _metrics.connectionsAccepted);
+    Write(out, "ircserv_connections_closed_total", "counter", "Client connections closed.", _metrics.connectionsClosed);
+    Write(out, "ircserv_clients", "gauge", "Connected clients.", _metrics.connectionsAccepted - _metrics.connectionsClosed);
+    Write(out, "ircserv_channels", "gauge", "Open channels.", _channels.size());
+    Write(out, "ircserv_received_bytes_total", "counter", "Bytes read from clients.", _metrics.bytesIn);
+    Write(out, "ircserv_sent_bytes_total", "counter", "Bytes written to clients.", BytesOut());
+    Write(out, "ircserv_queued_messages_total", "counter", "Lines put in send queues.", _metrics.messagesQueued);
+    Write(out, "ircserv_write_calls_total", "counter", "Socket writes, each carrying one or more queued lines.", WriteCalls());
+    Write(out, "ircserv_write_calls_per_1k_messages", "gauge", "Socket writes per 1000 queued lines since startup.", WriteCallsPer1k());
+    Write(out, "ircserv_send_queue_clients", "gauge", "Clients with output waiting.", queues.clients);
+    Write(out, "ircserv_send_queue_messages", "gauge", "Messages waiting in send queues.", queues.messages);
+    Write(out, "ircserv_send_queue_bytes", "gauge", "Bytes waiting in send queues.", queues.bytes);
+    Write(out, "ircserv_send_queue_max_bytes", "gauge", "Longest send queue in bytes.", queues.maxBytes);
+    Write(out, "ircserv_send_queue_exceeded_total", "counter", "Clients dropped for exceeding their SendQ.", _metrics.sendQueueExceeded);
+    Write(out, "ircserv_client_memory_bytes", "gauge", "Memory held for all clients.", queues.memory);
+    Write(out, "ircserv_client_memory_max_bytes", "gauge", "Memory held for the largest client.", queues.maxMemory);
+    Write(out, "ircserv_dropped_sends_total", "counter", "Messages dropped for dead or closing clients.", DroppedSends());
+    Write(out, "ircserv_flood_throttled_total", "counter", "Times a client ran out of flood control tokens.", _metrics.floodThrottled);
+    Write(out, "ircserv_unknown_commands_total", "counter", "Lines with an unknown command.", _metrics.unknownCommands);
+    Write(out, "ircserv_log_dropped_total", "counter", "Log records dropped on a full log ring.", Logger::Dropped());
+
+    out << "# HELP ircserv_commands_total Lines handled per command.\n"
+        << "# TYPE ircserv_commands_total counter\n";
+    for (int id = 0; id < CommandCount; id++)
+        out << "ircserv_commands_total{command=\"" << CommandTable[id].name << "\"} " << _metrics.commandCounts[id] << "\n";
+
+    static const double Quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    out << "# HELP ircserv_command_duration_seconds Time spent in the command handlers.\n"
+        << "# TYPE ircserv_command_duration_seconds summary\n";
+    for (int id = 0; id < CommandCount; id++)
+    {
+        const Histogram &latency = _metrics.commandLatency[id];
+        if (latency.count() == 0)
+            continue;
+        for (size_t i = 0; i < sizeof(Quantiles) / sizeof(Quantiles[0]); i++)
+            out << "ircserv_command_duration_seconds{command=\"" << CommandTable[id].name << "\",quantile=\""
+                << Quantiles[i] << "\"} " << latency.percentile(Quantiles[i]) / 1e9 << "\n";
+        out << "ircserv_command_duration_seconds_sum{command=\"" << CommandTable[id].name << "\"} " << latency.sum() / 1e9 << "\n"
+            << "ircserv_command_duration_seconds_count{command=\"" << CommandTable[id].name << "\"} " << latency.count() << "\n";
+    }
+    return out.str();
+}
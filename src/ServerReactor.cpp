@@ -0,0 +1,158 @@
+#include "../inc/Server.hpp"
+
+const size_t SHARD_EVENT_QUEUE_SIZE = 65536;
+const size_t SHARD_EVENT_BATCH = 4096; // events handled before timers and the metrics socket get a turn
+
+// I/O offload mode, reactor_threads > 0. The reactor threads own the
+// sockets and do all of the network I/O. The IRC state (_clients, _nicks,
+// _channels, the timers and the metrics) stays with the thread in Run(), so
+// the command handlers run unchanged and without locks. The two sides only
+// talk through MpscQueues: the shards post what they read, the server posts
+// what to send. This is not channel sharding: every command and fan-out is
+// still on the server thread, and every read is copied once into a
+// ShardData event on its way there.
+void Server::StartShards()
+{
+    unsigned int threads = _config.reactorThreads;
+#ifndef SO_REUSEPORT
+    if (threads > 1)
+    {
+        LOG_WARNING("SO_REUSEPORT is not available, using a single reactor thread");
+        threads = 1;
+    }
+#endif
+    _ioMode = IoShards;
+    _shardEvents = new MpscQueue<ShardEvent>(SHARD_EVENT_QUEUE_SIZE);
+    if (!_shardWakeup.open() || !_poller.add(_shardWakeup.fd(), PollIn))
+    {
+        LOG_ERROR("Failed to create the reactor wakeup pipe: %s", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned int i = 0; i < threads; i++)
+    {
+        _shards.push_back(new ReactorShard(i, *_shardEvents, _shardWakeup));
+        if (!_shards.back()->Start(_port))
+        {
+            StopShards();
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void Server::StopShards()
+{
+    for (std::vector<ReactorShard*>::iterator it = _shards.begin(); it != _shards.end(); it++)
+        delete *it;
+    _shards.clear();
+    if (_shardEvents == NULL)
+        return;
+    ShardEvent event;
+    while (_shardEvents->pop(event))
+    {
+        if (event.type == ShardClosed)
+            close(event.fd);
+        std::free(event.data);
+    }
+    delete _shardEvents;
+    _shardEvents = NULL;
+}
+
+void Server::RunShards()
+{
+    std::vector<PollEvent> events;
+    bool behind = false;
+    while (true)
+    {
+        int ready = _poller.wait(events, behind ? 0 : WaitTimeoutMs());
+        _nowMs = MonotonicNs() / 1000000;
+        if (ready == -1)
+        {
+            LOG_ERROR("Failed to wait for socket activity: %s", strerror(errno));
+            continue;
+        }
+        for (std::vector<PollEvent>::iterator event = events.begin(); event != events.end(); event++)
+        {
+            if (event->fd == _metricsSocketFd)
+                AcceptMetrics();
+        }
+        _shardWakeup.clear();
+        behind = HandleShardEvents();
+        RunTimers();
+        DropSlowClients();
+        WriteSnapshotSlice();
+        _journal.flush();
+        // One wakeup per shard and iteration, however many lines it was given
+        for (std::vector<ReactorShard*>::iterator it = _shards.begin(); it != _shards.end(); it++)
+            (*it)->Wake();
+    }
+}
+
+// Returns true when it stopped with events left in the queue
+bool Server::HandleShardEvents()
+{
+    ShardEvent event;
+    for (size_t handled = 0; handled < SHARD_EVENT_BATCH; handled++)
+    {
+        if (!_shardEvents->pop(event))
+            return false;
+        if (event.type == ShardAccepted)
+        {
+            Client *client = AddClient(event.fd, event.address);
+            client->_shard = event.shard;
+            client->_generation = event.generation;
+            continue;
+        }
+        Client *client = FindShardClient(event);
+        if (event.type == ShardData)
+        {
+            if (client)
+            {
+                _metrics.bytesIn += event.size;
+                client->_lastActivity = _nowMs;
+                client->_input.append(event.data, event.size);
+                if (!client->_throttled)
+                    ProcessInput(client);
+                if (!client->_online)
+                    RemoveClient(client);
+            }
+            std::free(event.data);
+        }
+        else if (event.type == ShardClosed && client)
+        {
+            LOG_INFO("Client disconnected. Socket descriptor: %d", event.fd);
+            if (client->_status == UsernameRegistered)
+                Quit(*client, std::vector<std::string>());
+            client->_online = false;
+            RemoveClient(client);
+        }
+        else if (event.type == ShardSendQueueExceeded && client && !client->_sendQueueExceeded)
+        {
+            client->_sendQueueExceeded = true;
+            _slowClients.push_back(event.fd);
+        }
+    }
+    return true;
+}
+
+// Events about a connection the server already let go of are stale, the
+// socket may belong to a new client by now
+Client *Server::FindShardClient(const ShardEvent &event)
+{
+    if (static_cast<size_t>(event.fd) >= _clients.size())
+        return NULL;
+    Client *client = _clients[event.fd];
+    if (client == NULL || client->_shard != event.shard || client->_generation != event.generation)
+        return NULL;
+    return client;
+}
+
+void Server::PostToShard(Client &client, ShardCommandType type, const MessageRef &message)
+{
+    ShardCommand command;
+    command.type = type;
+    command.fd = client.getSocketFd();
+    command.generation = client._generation;
+    command.sendQueueLimit = (type == ShardSend) ? SendQueueLimit(client) : 0;
+    command.message = message;
+    _shards[client._shard]->Post(command);
+}
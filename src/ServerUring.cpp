@@ -0,0 +1,320 @@
+#include "../inc/Server.hpp"
+
+#ifdef USE_URING
+#include <climits>
+#include <poll.h>
+
+const unsigned URING_ENTRIES = 4096;
+const unsigned RECV_BUFFERS = 1024; // shared by all connections, a power of two
+
+// user_data of the completions. A client's operations carry the Client
+// pointer with the operation in the low bits, the rest are fixed tags.
+enum UringTag
+{
+    TagIgnore,
+    TagAccept,
+    TagMetrics,
+};
+
+enum UringOp
+{
+    OpRecv = 1,
+    OpSend = 2,
+    OpHangup = 3,
+    OpMask = 7
+};
+
+static unsigned long long ClientTag(Client &client, UringOp op)
+{
+    return reinterpret_cast<unsigned long long>(&client) | op;
+}
+
+// The io_uring loop replaces Run() and Serve() for the single-threaded
+// server: one multishot accept, one multishot recv per connection reading
+// into a shared ring of provided buffers, and one sendmsg per connection
+// carrying every queued line at once. Everything prepared during an
+// iteration is submitted together with the wait, in a single system call.
+bool Server::StartUring()
+{
+    _uring = new Uring();
+    if (!_uring->open(URING_ENTRIES) || !_uring->provideBuffers(RECV_BUFFERS, BUFFER_SIZE))
+    {
+        LOG_WARNING("io_uring is not usable on this kernel, falling back to %s", Poller::backend());
+        delete _uring;
+        _uring = NULL;
+        return false;
+    }
+    _ioMode = IoUring;
+    return true;
+}
+
+void Server::RunUring()
+{
+    UringArmAccept();
+    if (_metricsSocketFd != -1)
+        UringArmMetrics();
+    io_uring_cqe cqe;
+    while (true)
+    {
+        FlushPending();
+        if (_uring->enter(WaitTimeoutMs()) == -1)
+            LOG_ERROR("Failed to wait for io_uring completions: %s", strerror(errno));
+        _nowMs = MonotonicNs() / 1000000;
+        while (_uring->next(cqe))
+            UringCompletion(cqe);
+        RunTimers();
+        DropSlowClients();
+        WriteSnapshotSlice();
+        _journal.flush();
+    }
+}
+
+void Server::UringArmAccept()
+{
+    io_uring_sqe *sqe = _uring->sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = _serverSocketFd;
+    sqe->ioprio = _multishotAccept ? IORING_ACCEPT_MULTISHOT : 0;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = TagAccept;
+}
+
+void Server::UringArmMetrics()
+{
+    io_uring_sqe *sqe = _uring->sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = _metricsSocketFd;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = TagMetrics;
+}
+
+// Kernels before 6.0 refuse multishot recv, one recv per completion then
+void Server::UringArmRecv(Client &client)
+{
+    io_uring_sqe *sqe = _uring->sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = client.getSocketFd();
+    sqe->ioprio = _multishotRecv ? IORING_RECV_MULTISHOT : 0;
+    sqe->len = _multishotRecv ? 0 : BUFFER_SIZE;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = Uring::BufferGroup;
+    sqe->user_data = ClientTag(client, OpRecv);
+    client._recvArmed = true;
+}
+
+// The recv completes with -ECANCELED, or with data that beat the cancel
+void Server::UringCancelRecv(Client &client)
+{
+    io_uring_sqe *sqe = _uring->sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = ClientTag(client, OpRecv);
+    sqe->user_data = TagIgnore;
+}
+
+// The recv of a throttled client is cancelled, which would leave a peer
+// that resets or closes the connection unnoticed until the throttling ends.
+// The poller still reports errors and hang-ups on a socket it does not read.
+void Server::UringArmHangup(Client &client)
+{
+    io_uring_sqe *sqe = _uring->sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = client.getSocketFd();
+    sqe->poll32_events = POLLRDHUP | POLLHUP | POLLERR;
+    sqe->user_data = ClientTag(client, OpHangup);
+    client._hangupArmed = true;
+}
+
+void Server::UringCancelHangup(Client &client)
+{
+    io_uring_sqe *sqe = _uring->sqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = ClientTag(client, OpHangup);
+    sqe->user_data = TagIgnore;
+}
+
+// One sendmsg for as much of the queue as fits in MAX_WRITE_IOV lines. The
+// lines stay in the queue, which keeps their bytes alive, until the
+// completion says how much was sent.
+void Server::UringSend(Client &client)
+{
+    client._sendIov.resize(std::min(MAX_WRITE_IOV, static_cast<size_t>(IOV_MAX)));
+    size_t count = GatherQueue(client._sendQueue, client._sendOffset, &client._sendIov[0], client._sendIov.size());
+    std::memset(&client._sendMsg, 0, sizeof(client._sendMsg));
+    client._sendMsg.msg_iov = &client._sendIov[0];
+    client._sendMsg.msg_iovlen = count;
+
+    io_uring_sqe *sqe = _uring->sqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = client.getSocketFd();
+    sqe->addr = reinterpret_cast<unsigned long long>(&client._sendMsg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = ClientTag(client, OpSend);
+    client._sendInFlight = count;
+    _metrics.writeCalls++;
+}
+
+// A client has one send in flight at most, the lines queued meanwhile go
+// out with the next one
+void Server::UringFlush(Client &client)
+{
+    if (client._sendInFlight == 0 && !client._sendQueue.empty())
+        UringSend(client);
+    else if (client._closing)
+        UringFinish(client);
+}
+
+void Server::UringCompletion(const io_uring_cqe &cqe)
+{
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+    if (cqe.user_data == TagIgnore)
+        return;
+    if (cqe.user_data == TagMetrics)
+    {
+        AcceptMetrics();
+        if (!more)
+            UringArmMetrics();
+        return;
+    }
+    if (cqe.user_data == TagAccept)
+    {
+        if (cqe.res >= 0)
+            UringAccepted(cqe.res);
+        else if (cqe.res == -EINVAL && _multishotAccept)
+        {
+            LOG_INFO("Multishot accept is not supported, accepting one connection at a time");
+            _multishotAccept = false;
+        }
+        else if (cqe.res != -EAGAIN && cqe.res != -EINTR)
+            LOG_WARNING("Failed to accept client connection: %s", strerror(-cqe.res));
+        if (!more)
+            UringArmAccept();
+        return;
+    }
+    Client &client = *reinterpret_cast<Client*>(cqe.user_data & ~static_cast<unsigned long long>(OpMask));
+    if ((cqe.user_data & OpMask) == OpSend)
+        UringSent(client, cqe.res);
+    else if ((cqe.user_data & OpMask) == OpHangup)
+        UringHangup(client, cqe.res);
+    else
+        UringReceived(client, cqe.res, cqe.flags);
+}
+
+void Server::UringAccepted(int clientSocket)
+{
+    sockaddr_in clientAddress;
+    socklen_t clientAddressLength = sizeof(clientAddress);
+    std::memset(&clientAddress, 0, sizeof(clientAddress));
+    getpeername(clientSocket, reinterpret_cast<struct sockaddr *>(&clientAddress), &clientAddressLength);
+    SetNoDelay(clientSocket);
+    Client *client = AddClient(clientSocket, clientAddress);
+    if (client == NULL)
+        close(clientSocket);
+    else
+        UringArmRecv(*client);
+}
+
+// Same as Serve(): the bytes are copied into the client's input buffer and
+// the provided buffer goes straight back to the ring
+void Server::UringReceived(Client &client, int result, unsigned int flags)
+{
+    if (!(flags & IORING_CQE_F_MORE))
+        client._recvArmed = false;
+    if (flags & IORING_CQE_F_BUFFER)
+    {
+        unsigned id = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (result > 0 && !client._closing)
+            client._input.append(_uring->buffer(id), result);
+        _uring->recycle(id);
+    }
+    if (client._closing)
+        return UringFinish(client);
+
+    if (result > 0)
+    {
+        _metrics.bytesIn += result;
+        client._lastActivity = _nowMs;
+        if (!client._throttled)
+            ProcessInput(&client);
+    }
+    else if (result == -EINVAL && _multishotRecv)
+    {
+        LOG_INFO("Multishot recv is not supported, receiving one buffer at a time");
+        _multishotRecv = false;
+    }
+    else if (result != -ENOBUFS && result != -ECANCELED && result != -EINTR)
+    {
+        if (result == 0)
+            LOG_INFO("Client disconnected. Socket descriptor: %d", client.getSocketFd());
+        else
+            LOG_WARNING("Failed to read from client socket %d: %s", client.getSocketFd(), strerror(-result));
+        if (client._status == UsernameRegistered)
+            Quit(client, std::vector<std::string>());
+        client._online = false;
+    }
+    if (!client._online)
+        return RemoveClient(&client);
+    if (!client._recvArmed && !client._throttled)
+        UringArmRecv(client);
+}
+
+void Server::UringSent(Client &client, int result)
+{
+    client._sendInFlight = 0;
+    if (result > 0)
+    {
+        _metrics.bytesOut += result;
+        client._sendQueueBytes -= result;
+        ConsumeQueue(client._sendQueue, client._sendOffset, result);
+    }
+    else if (result < 0)
+    {
+        // The peer is gone, the recv reports it and cleans up
+        if (!client._closing)
+            LOG_WARNING("Failed to send queued data to %s: %s", client._nick.c_str(), strerror(-result));
+        DropSendQueue(client);
+    }
+    // A closing client gets one send, like the last flush in RemoveClient
+    if (client._closing)
+    {
+        DropSendQueue(client);
+        return UringFinish(client);
+    }
+    flushClient(client);
+}
+
+// The lines a throttled client left unread go with it, as when the recv
+// reports the end of the connection
+void Server::UringHangup(Client &client, int result)
+{
+    client._hangupArmed = false;
+    if (client._closing)
+        return UringFinish(client);
+    // Removed on resume. The client may have been throttled again before
+    // the removal completed, the poll could not be armed twice then.
+    if (result <= 0)
+    {
+        if (result == -ECANCELED && client._throttled)
+            UringArmHangup(client);
+        return;
+    }
+    LOG_INFO("Client disconnected. Socket descriptor: %d", client.getSocketFd());
+    if (client._status == UsernameRegistered)
+        Quit(client, std::vector<std::string>());
+    client._online = false;
+    RemoveClient(&client);
+}
+
+// Closes the socket and gives the client back to the pool once nothing of
+// it is left in the kernel
+void Server::UringFinish(Client &client)
+{
+    if (!client._closing || client._recvArmed || client._hangupArmed || client._sendInFlight || client._flushPending)
+        return;
+    close(client.getSocketFd());
+    _clientPool.release(&client);
+}
+#endif
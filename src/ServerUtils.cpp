@@ -2,64 +2,93 @@
 
 bool Server::IsExistClient(const std::string &ClientName)
 {
-    for (std::vector<Client*>::iterator it = _clients.begin(); it != _clients.end(); it++)
-    {
-        if ((*it)->_nick == ClientName)
-            return true;
-    }
-    return false;
+    return findClient(ClientName) != NULL;
 }
 
 bool Server::IsExistChannel(const std::string &ChannelName)
 {
-    std::map<std::string, class Channel*>::iterator it = _channels.find(ChannelName);
-    return (it != _channels.end()) ? true : false;
+    return findChannel(ChannelName) != NULL;
 }
 
-bool Server::IsBannedClient(Client &client, const std::string &ChannelName)
+// The checks below take the channel a command looked up once with
+// findChannel(), so a name is folded once per command
+// The channel operator is never kept out by a ban
+bool Server::IsBannedClient(Client &client, Channel &chan)
 {
-    std::vector<Client*>::iterator it = _channels.at(ChannelName)->getBanned().begin();
-    std::vector<Client*>::iterator end = _channels.at(ChannelName)->getBanned().end();
-    for (; it != end; it++)
-    {
-        if ((*it)->_nick == client._nick)
-            return true;
-    }
-    return false;
+    return chan.getOperator() != &client && chan.isBanned(client);
+}
+
+bool Server::IsInvited(Client &client, Channel &chan)
+{
+    return client._invitedchan == chan._foldedName || chan.isInviteException(client);
+}
+
+bool Server::IsInChannel(Client &client, Channel &chan)
+{
+    return chan.getMembers().contains(&client);
+}
+
+bool Server::IsOperator(Client &client, Channel &chan)
+{
+    return chan.getOperator() == &client;
+}
+
+bool Server::HasChannelKey(Channel &chan)
+{
+    return !chan.getKey().empty();
 }
 
-bool Server::IsInChannel(Client &client, const std::string &ChannelName)
+bool Server::IsChannelLimitFull(Channel &chan)
 {
-    return (client._channel.find(ChannelName) != client._channel.end()) ? true : false;
+    size_t members = chan.getMembers().size();
+    if (_config.maxChannelUsers && members >= _config.maxChannelUsers)
+        return true;
+    return (chan._mode & ChannelLimit) && members >= chan._clientLimit;
 }
 
-bool Server::IsOperator(Client &client, const std::string& ChannelName)
+bool Server::HasTooManyChannels(Client &client)
 {
-    return _channels.at(ChannelName)->getOperator()->_nick == client._nick;
+    return _config.maxChannelsPerUser && client._channel.size() >= _config.maxChannelsPerUser;
 }
 
-bool Server::HasChannelKey(const std::string &ChannelName)
+// NULL when nobody uses that nickname
+Client *Server::findClient(const std::string &NickName)
 {
-    return !_channels.at(ChannelName)->getKey().empty();
+    FoldCaseInto(NickName, _foldBuffer);
+    std::tr1::unordered_map<std::string, Client*>::iterator it = _nicks.find(_foldBuffer);
+    return (it != _nicks.end()) ? it->second : NULL;
 }
 
-bool Server::IsChannelLimitFull(const std::string &ChannelName)
+// NULL when no such channel is open
+Channel *Server::findChannel(const std::string &ChannelName)
 {
-    return _channels.at(ChannelName)->getMembers().size() == _channels.at(ChannelName)->_clientLimit;
+    FoldCaseInto(ChannelName, _foldBuffer);
+    std::map<std::string, Channel*>::iterator it = _channels.find(_foldBuffer);
+    return (it != _channels.end()) ? it->second : NULL;
 }
 
-// Always use under IsExistClient!!!
-Client &Server::findClient(const std::string &NickName)
+// Every nickname change goes through here to keep _nicks in sync. The
+// nickname keeps the case it was given, only the key is folded.
+void Server::setClientNick(Client &client, const std::string &NickName)
 {
-    for (std::vector<Client*>::iterator it = _clients.begin(); it != _clients.end(); it++)
-    { 
-        if ((*it)->_nick == NickName)
-            return (**it);
+    if (!client._nick.empty())
+        _nicks.erase(client._foldedNick);
+    client._nick = NickName;
+    FoldCaseInto(NickName, client._foldedNick);
+    _nicks[client._foldedNick] = &client;
+    client.updateMask();
+    // The channels remember their operator by nick
+    for (std::map<std::string, Channel*>::iterator it = client._channel.begin(); it != client._channel.end(); it++)
+    {
+        if (it->second->getOperator() == &client)
+        {
+            it->second->setOperator(&client);
+            JournalOperator(*it->second);
+        }
     }
-    return *_clients[-1];
 }
 
-int Server::ParamsSizeControl(Client& client, const std::string& Command, std::vector<std::string> params, size_t necessary, size_t optional)
+int Server::ParamsSizeControl(Client& client, const std::string& Command, const std::vector<std::string> &params, size_t necessary, size_t optional)
 {
     int err = 0;
     if (params.size() < necessary)
@@ -100,3 +129,35 @@ const std::string& Server::getPassword() const
 {
     return _password;
 }
+
+unsigned long Server::getCommandCount(CommandId id) const
+{
+    return _metrics.commandCounts[id];
+}
+
+unsigned long Server::getUnknownCommandCount() const
+{
+    return _metrics.unknownCommands;
+}
+
+// Closes the channel when the client was its last member, and hands the
+// operator status to the next member when the client held it
+void Server::RemoveFromChannel(Client &client, Channel &chan)
+{
+    bool wasOperator = IsOperator(client, chan);
+    chan.removeMember(client);
+    if (chan.getMembers().size() == 0)
+    {
+        JournalDrop(chan);
+        _channels.erase(chan._foldedName);
+        chan._history.clear(); // a pooled channel should not keep the lines alive
+        _channelPool.release(&chan);
+    }
+    else if (wasOperator)
+    {
+        Client *next_op = chan.getMembers().front();
+        chan.setOperator(next_op);
+        JournalOperator(chan);
+        sendServerToChannel(chan, MODE(std::string("ircserv"), chan._name, "+o", next_op->_nick));
+    }
+}
@@ -0,0 +1,122 @@
+#include "../inc/TimerWheel.hpp"
+
+Timer::Timer() : prev(NULL), next(NULL), expires(0), owner(NULL)
+{
+}
+
+bool Timer::armed() const
+{
+    return next != NULL;
+}
+
+TimerWheel::TimerWheel(unsigned long long nowMs) : _current(nowMs / TICK_MS), _count(0)
+{
+    for (int level = 0; level < LEVELS; level++)
+    {
+        for (int slot = 0; slot < SLOTS; slot++)
+        {
+            _slots[level][slot].prev = &_slots[level][slot];
+            _slots[level][slot].next = &_slots[level][slot];
+        }
+    }
+}
+
+// Level n holds the timers due within 64^(n+1) ticks, indexed by the bits of
+// their tick that level n is about
+void TimerWheel::link(Timer &timer)
+{
+    unsigned long long delta = timer.expires - _current;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * (level + 1))))
+        level++;
+    Timer &head = _slots[level][(timer.expires >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    timer.prev = head.prev;
+    timer.next = &head;
+    head.prev->next = &timer;
+    head.prev = &timer;
+    _count++;
+}
+
+void TimerWheel::unlink(Timer &timer)
+{
+    timer.prev->next = timer.next;
+    timer.next->prev = timer.prev;
+    timer.prev = NULL;
+    timer.next = NULL;
+    _count--;
+}
+
+// Spreads one slot of a coarse level over the finer ones. Runs with _current
+// already on the tick being processed: the slot holds the timers due within
+// the next 64^level ticks, all of which fit in the levels below, and a timer
+// due on this very tick lands in the level 0 slot fired right after.
+void TimerWheel::cascade(int level, unsigned long long tick)
+{
+    Timer &head = _slots[level][(tick >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    while (head.next != &head)
+    {
+        Timer *timer = head.next;
+        unlink(*timer);
+        link(*timer);
+    }
+}
+
+void TimerWheel::schedule(Timer &timer, unsigned long long expiresMs)
+{
+    if (timer.armed())
+        unlink(timer);
+    unsigned long long tick = expiresMs / TICK_MS;
+    unsigned long long horizon = (1ULL << (SLOT_BITS * LEVELS)) - 1;
+    if (tick <= _current)
+        tick = _current + 1;
+    else if (tick - _current > horizon)
+        tick = _current + horizon;
+    timer.expires = tick;
+    link(timer);
+}
+
+void TimerWheel::cancel(Timer &timer)
+{
+    if (timer.armed())
+        unlink(timer);
+}
+
+void TimerWheel::advance(unsigned long long nowMs, std::vector<Timer*> &expired)
+{
+    unsigned long long target = nowMs / TICK_MS;
+    while (_current < target)
+    {
+        if (_count == 0)
+        {
+            _current = target;
+            break;
+        }
+        unsigned long long tick = ++_current;
+        for (int level = LEVELS - 1; level > 0; level--)
+        {
+            // Level n wraps when the low SLOT_BITS * n bits of the tick are all zero
+            if ((tick & ((1ULL << (SLOT_BITS * level)) - 1)) == 0)
+                cascade(level, tick);
+        }
+        Timer &head = _slots[0][tick & (SLOTS - 1)];
+        while (head.next != &head)
+        {
+            Timer *timer = head.next;
+            unlink(*timer);
+            expired.push_back(timer);
+        }
+    }
+}
+
+int TimerWheel::timeoutMs(unsigned long long nowMs) const
+{
+    if (_count == 0)
+        return -1;
+    unsigned long long next = (_current + 1) * TICK_MS;
+    return (next > nowMs) ? static_cast<int>(next - nowMs) : 0;
+}
+
+size_t TimerWheel::size() const
+{
+    return _count;
+}
@@ -0,0 +1,250 @@
+#include "../inc/Uring.hpp"
+
+#ifdef USE_URING
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+
+static int Setup(unsigned entries, io_uring_params &params)
+{
+    return syscall(__NR_io_uring_setup, entries, &params);
+}
+
+static int Enter(int fd, unsigned submit, unsigned waitFor, unsigned flags, void *arg, size_t argSize)
+{
+    return syscall(__NR_io_uring_enter, fd, submit, waitFor, flags, arg, argSize);
+}
+
+static int Register(int fd, unsigned opcode, void *arg, unsigned count)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+Uring::Uring() : _fd(-1), _rings(MAP_FAILED), _ringsSize(0), _sqes(static_cast<io_uring_sqe*>(MAP_FAILED)), _sqesSize(0),
+                 _bufferRing(static_cast<io_uring_buf_ring*>(MAP_FAILED)), _bufferRingSize(0), _buffers(NULL),
+                 _bufferCount(0), _bufferSize(0), _bufferTail(0)
+{
+}
+
+Uring::~Uring()
+{
+    if (_fd != -1)
+        close(_fd);
+    if (_rings != MAP_FAILED)
+        munmap(_rings, _ringsSize);
+    if (_sqes != MAP_FAILED)
+        munmap(_sqes, _sqesSize);
+    if (_bufferRing != MAP_FAILED)
+        munmap(_bufferRing, _bufferRingSize);
+    std::free(_buffers);
+}
+
+bool Uring::open(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    _fd = Setup(entries, params);
+    if (_fd == -1)
+        return false;
+    // Timed waits in enter(), no dropped completions and SQEs that may be
+    // reused once submitted
+    unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_SUBMIT_STABLE | IORING_FEAT_EXT_ARG;
+    if ((params.features & needed) != needed)
+        return false;
+
+    const unsigned char ops[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL};
+    size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    io_uring_probe *probe = static_cast<io_uring_probe*>(std::calloc(1, probeSize));
+    if (probe == NULL)
+        return false;
+    bool supported = Register(_fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; supported && i < sizeof(ops); i++)
+        supported = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    std::free(probe);
+    if (!supported)
+        return false;
+
+    _ringsSize = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                          params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    _rings = mmap(NULL, _ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+    if (_rings == MAP_FAILED)
+        return false;
+    _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    _sqes = static_cast<io_uring_sqe*>(mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES));
+    if (_sqes == MAP_FAILED)
+        return false;
+
+    char *rings = static_cast<char*>(_rings);
+    _sqHead = reinterpret_cast<unsigned*>(rings + params.sq_off.head);
+    _sqTail = reinterpret_cast<unsigned*>(rings + params.sq_off.tail);
+    _sqArray = reinterpret_cast<unsigned*>(rings + params.sq_off.array);
+    _sqMask = *reinterpret_cast<unsigned*>(rings + params.sq_off.ring_mask);
+    _sqEntries = params.sq_entries;
+    _cqHead = reinterpret_cast<unsigned*>(rings + params.cq_off.head);
+    _cqTail = reinterpret_cast<unsigned*>(rings + params.cq_off.tail);
+    _cqes = reinterpret_cast<io_uring_cqe*>(rings + params.cq_off.cqes);
+    _cqMask = *reinterpret_cast<unsigned*>(rings + params.cq_off.ring_mask);
+    return true;
+}
+
+// Receives pick a buffer themselves, so an idle connection holds no memory.
+// The buffers go into a ring shared with the kernel, or are handed over with
+// IORING_OP_PROVIDE_BUFFERS where the ring cannot be registered or does not
+// deliver. count must be a power of two.
+bool Uring::provideBuffers(unsigned count, unsigned size)
+{
+    _buffers = static_cast<char*>(std::malloc(static_cast<size_t>(count) * size));
+    if (_buffers == NULL)
+        return false;
+    _bufferCount = count;
+    _bufferSize = size;
+
+    io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_entries = count;
+    reg.bgid = BufferGroup;
+    _bufferRingSize = count * sizeof(io_uring_buf);
+    _bufferRing = static_cast<io_uring_buf_ring*>(mmap(NULL, _bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    reg.ring_addr = reinterpret_cast<unsigned long>(_bufferRing);
+    if (_bufferRing != MAP_FAILED && Register(_fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0)
+    {
+        for (unsigned id = 0; id < count; id++)
+            recycle(id);
+        if (testBuffers())
+            return true;
+        Register(_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+    if (_bufferRing != MAP_FAILED)
+        munmap(_bufferRing, _bufferRingSize);
+    _bufferRing = static_cast<io_uring_buf_ring*>(MAP_FAILED);
+
+    io_uring_sqe *entry = sqe();
+    entry->opcode = IORING_OP_PROVIDE_BUFFERS;
+    entry->fd = count;
+    entry->addr = reinterpret_cast<unsigned long>(_buffers);
+    entry->len = size;
+    entry->buf_group = BufferGroup;
+    return testBuffers();
+}
+
+// One recv on a socketpair, run before the server uses the ring
+bool Uring::testBuffers()
+{
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == -1)
+        return false;
+    bool delivered = false;
+    if (write(pair[1], "", 1) == 1)
+    {
+        io_uring_sqe *entry = sqe();
+        entry->opcode = IORING_OP_RECV;
+        entry->fd = pair[0];
+        entry->flags = IOSQE_BUFFER_SELECT;
+        entry->buf_group = BufferGroup;
+        entry->len = _bufferSize;
+        entry->user_data = 1;
+        io_uring_cqe cqe;
+        bool answered = false;
+        for (int tries = 0; tries < 3 && !answered && enter(1000) != -1; tries++)
+        {
+            while (!answered && next(cqe))
+                answered = cqe.user_data == 1;
+        }
+        delivered = answered && cqe.res == 1 && (cqe.flags & IORING_CQE_F_BUFFER);
+        if (delivered)
+            recycle(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+    }
+    close(pair[0]);
+    close(pair[1]);
+    return delivered;
+}
+
+bool Uring::bufferRing() const
+{
+    return _bufferRing != MAP_FAILED;
+}
+
+io_uring_sqe *Uring::sqe()
+{
+    unsigned tail = *_sqTail;
+    if (tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) == _sqEntries)
+        submit(0, 0);
+    unsigned index = tail & _sqMask;
+    io_uring_sqe *entry = &_sqes[index];
+    std::memset(entry, 0, sizeof(*entry));
+    _sqArray[index] = index;
+    __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+    return entry;
+}
+
+int Uring::submit(unsigned waitFor, int timeoutMs)
+{
+    unsigned pending = *_sqTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    if (waitFor == 0)
+        return Enter(_fd, pending, 0, 0, NULL, 0);
+    __kernel_timespec timeout;
+    io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    if (timeoutMs >= 0)
+    {
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+        arg.ts = reinterpret_cast<unsigned long>(&timeout);
+    }
+    return Enter(_fd, pending, waitFor, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+// Does not wait when completions are already there
+int Uring::enter(int timeoutMs)
+{
+    bool ready = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE) != *_cqHead;
+    int result = ready ? submit(0, 0) : submit(1, timeoutMs);
+    if (result == -1 && (errno == ETIME || errno == EINTR))
+        return 0;
+    return result;
+}
+
+bool Uring::next(io_uring_cqe &cqe)
+{
+    unsigned head = *_cqHead;
+    if (head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+        return false;
+    cqe = _cqes[head & _cqMask];
+    __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+const char *Uring::buffer(unsigned id) const
+{
+    return _buffers + static_cast<size_t>(id) * _bufferSize;
+}
+
+// Completions of the PROVIDE_BUFFERS fallback carry user_data 0
+void Uring::recycle(unsigned id)
+{
+    if (_bufferRing == MAP_FAILED)
+    {
+        io_uring_sqe *provide = sqe();
+        provide->opcode = IORING_OP_PROVIDE_BUFFERS;
+        provide->fd = 1;
+        provide->addr = reinterpret_cast<unsigned long>(_buffers + static_cast<size_t>(id) * _bufferSize);
+        provide->len = _bufferSize;
+        provide->buf_group = BufferGroup;
+        provide->off = id;
+        return;
+    }
+    // Not _bufferRing->bufs: in C++ the empty struct the header puts in
+    // front of that flexible array takes 8 bytes
+    io_uring_buf &entry = reinterpret_cast<io_uring_buf*>(_bufferRing)[_bufferTail & (_bufferCount - 1)];
+    entry.addr = reinterpret_cast<unsigned long>(_buffers + static_cast<size_t>(id) * _bufferSize);
+    entry.len = _bufferSize;
+    entry.bid = id;
+    _bufferTail++;
+    __atomic_store_n(&_bufferRing->tail, _bufferTail, __ATOMIC_RELEASE);
+}
+#endif
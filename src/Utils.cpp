@@ -1,14 +1,7 @@
 #include "../inc/Utils.hpp"
-
-std::string ToLowercase(const std::string& Names)
-{
-    std::string new_str(Names);
-    for (std::string::iterator it = new_str.begin(); it != new_str.end(); it++)
-    {
-        tolower(*it);
-    }
-    return new_str;
-}
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 bool InvalidPassword(const std::string &Password)
 {
@@ -61,3 +54,11 @@ std::vector<std::string> split(const std::string &s, const std::string &delimite
     res.push_back(s.substr(pos_start));
     return res;
 }
+
+// Replies are already batched per loop iteration, Nagle would only hold back
+// the second batch until the first one is acknowledged
+void SetNoDelay(int socket)
+{
+    int on = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
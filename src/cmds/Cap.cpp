@@ -1,13 +1,60 @@
 #include "../../inc/Server.hpp"
+#include <sstream>
 
 //CAP LS 302
-void Server::Cap(Client &client, std::vector<std::string> params)
+//CAP REQ :message-tags batch draft/chathistory
+//A request is acknowledged or refused as a whole, -cap disables one
+
+// The flag of a capability this server has, NULL for any other
+static bool *CapFlag(Client &client, const std::string &cap)
+{
+    if (cap == "message-tags")
+        return &client._messageTags;
+    if (cap == "batch")
+        return &client._batch;
+    if (cap == "draft/chathistory")
+        return &client._chatHistory;
+    return NULL;
+}
+
+// Every capability in the request is one this server has
+static bool KnownCaps(Client &client, const std::string &caps)
 {
+    std::istringstream list(caps);
+    std::string cap;
+    bool any = false;
+    while (list >> cap)
+    {
+        if (CapFlag(client, cap[0] == '-' ? cap.substr(1) : cap) == NULL)
+            return false;
+        any = true;
+    }
+    return any;
+}
+
+void Server::Cap(Client &client, const std::vector<std::string> &params)
+{
+    if (params.empty())
+        return;
     if (params[0] == "LS")
     {
-        sendServerToClient(client, RPL_ISUPPORT(client._nick));
+        sendServerToClient(client, RPL_ISUPPORT(client._nick, _tokens));
         sendServerToClient(client, CAP_LS);
     }
+    else if (params[0] == "REQ" && params.size() > 1)
+    {
+        std::string nick = client._nick.empty() ? "*" : client._nick;
+        if (!KnownCaps(client, params[1]))
+            return sendServerToClient(client, CAP_NAK(nick, params[1]));
+        std::istringstream list(params[1]);
+        std::string cap;
+        while (list >> cap)
+        {
+            bool enable = cap[0] != '-';
+            *CapFlag(client, enable ? cap : cap.substr(1)) = enable;
+        }
+        sendServerToClient(client, CAP_ACK(nick, params[1]));
+    }
     else if (params[0] == "END" && client._status == UsernameRegistered)
         sendServerToClient(client, RPL_WELCOME(client._nick, client._username));
 }
\ No newline at end of file
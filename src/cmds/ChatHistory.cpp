@@ -0,0 +1,96 @@
+#include "../../inc/Server.hpp"
+#include <cstdio>
+
+//CHATHISTORY LATEST <target> <* | msgid=<id> | timestamp=<time>> <limit>
+//CHATHISTORY BEFORE <target> <msgid=<id> | timestamp=<time>> <limit>
+//CHATHISTORY AFTER <target> <msgid=<id> | timestamp=<time>> <limit>
+//Messages come oldest first, exactly as the members got them, in a
+//BATCH +<ref> chathistory <target> ... BATCH -<ref>, also when there are none.
+//Only for clients that negotiated batch and draft/chathistory.
+
+//FAIL CHATHISTORY NEED_CAPABILITY
+//FAIL CHATHISTORY NEED_MORE_PARAMS
+//FAIL CHATHISTORY UNKNOWN_COMMAND
+//FAIL CHATHISTORY INVALID_TARGET
+//FAIL CHATHISTORY INVALID_PARAMS
+
+// Where the history splits around a reference: before is the first entry
+// not older than it, after the first entry newer than it
+static bool FindReference(const History &history, const std::string &ref, size_t &before, size_t &after)
+{
+    unsigned long long value;
+    if (ref.compare(0, 6, "msgid=") == 0)
+    {
+        char *end;
+        value = std::strtoull(ref.c_str() + 6, &end, 10);
+        if (ref.size() == 6 || *end != '\0')
+            return false;
+        before = history.findMsgid(value);
+        after = history.findMsgid(value + 1);
+        return true;
+    }
+    if (ref.compare(0, 10, "timestamp=") == 0 && ParseServerTime(ref.substr(10), value))
+    {
+        before = history.findTime(value);
+        after = history.findTime(value + 1);
+        return true;
+    }
+    return false;
+}
+
+void Server::ChatHistory(Client &client, const std::vector<std::string> &params)
+{
+    if(client._status != UsernameRegistered)
+        return sendServerToClient(client,ERR_NOTREGISTERED(client._nick));
+    if (!client._batch || !client._chatHistory)
+        return sendServerToClient(client, FAIL(std::string("CHATHISTORY"), "NEED_CAPABILITY", "draft/chathistory", "Negotiate batch and draft/chathistory first"));
+    if (params.size() < 4)
+        return sendServerToClient(client, FAIL(std::string("CHATHISTORY"), "NEED_MORE_PARAMS", "*", "Missing parameters"));
+    const std::string &sub = params[0];
+    if (sub != "LATEST" && sub != "BEFORE" && sub != "AFTER")
+        return sendServerToClient(client, FAIL(std::string("CHATHISTORY"), "UNKNOWN_COMMAND", sub, "Unknown subcommand"));
+    Channel *chan = findChannel(params[1]);
+    if (!chan || !IsInChannel(client, *chan))
+        return sendServerToClient(client, FAIL(std::string("CHATHISTORY"), "INVALID_TARGET", sub + " " + params[1], "Messages could not be retrieved"));
+
+    const History &history = chan->_history;
+    size_t before = history.size();
+    size_t after = 0;
+    char *end;
+    size_t limit = std::strtoul(params[3].c_str(), &end, 10);
+    bool everything = (sub == "LATEST" && params[2] == "*");
+    if (*end != '\0' || limit == 0 || (!everything && !FindReference(history, params[2], before, after)))
+        return sendServerToClient(client, FAIL(std::string("CHATHISTORY"), "INVALID_PARAMS", sub, "Invalid message reference or limit"));
+    limit = std::min(limit, static_cast<size_t>(_config.historyLength));
+
+    size_t first;
+    size_t last;
+    if (sub == "BEFORE")
+    {
+        last = before;
+        first = last - std::min(limit, last);
+    }
+    else if (sub == "AFTER")
+    {
+        first = after;
+        last = std::min(history.size(), after + limit);
+    }
+    else
+    {
+        last = history.size();
+        first = std::max(after, last - std::min(limit, last));
+    }
+    // The batch tag goes in front of each kept line as a separate fragment,
+    // the line itself is still the block the members got
+    char ref[24];
+    snprintf(ref, sizeof(ref), "%lu", ++_lastBatch);
+    sendServerToClient(client, BATCH_START(std::string(ref), "chathistory", chan->_name));
+    MessageRef tag = MessageRef::Fragment(std::string("@batch=") + ref + (client._messageTags ? ";" : " "));
+    for (size_t i = first; i < last; i++)
+    {
+        const HistoryEntry &entry = history[i];
+        queueMessage(client, tag);
+        queueMessage(client, client._messageTags ? entry.line.skip(1) : entry.line.skip(entry.tagLength));
+    }
+    sendServerToClient(client, BATCH_END(std::string(ref)));
+}
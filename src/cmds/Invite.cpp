@@ -11,24 +11,26 @@
 //ERR_NOSUCHNICK (401) *
 
 
-void Server::Invite(Client &client, std::vector<std::string> params)
+void Server::Invite(Client &client, const std::vector<std::string> &params)
 {
     if(client._status != UsernameRegistered)
         return sendServerToClient(client,ERR_NOTREGISTERED(client._nick));
     if (ParamsSizeControl(client, "INVITE", params, 2, 0) != 0)
         return;
-    if (IsExistClient(params[1]) && IsExistChannel(params[0]) && IsInChannel(client,params[0]))
+    Client *found = findClient(params[1]);
+    Channel *chan = findChannel(params[0]);
+    if (found && chan && IsInChannel(client, *chan))
     {
-        Client& invited = findClient(params[1]);
-        invited._invitedchan = params[0];
-        if (IsInChannel(invited, params[0]))
+        Client& invited = *found;
+        invited._invitedchan = chan->_foldedName;
+        if (IsInChannel(invited, *chan))
             return sendServerToClient(client, ERR_USERONCHANNEL(client._nick, invited._nick, params[0]));
             
         std::vector<std::string> channel;
         channel.push_back(params[0]);
-        if ((_channels.at(params[0])->_mode & InviteOnly) && IsOperator(client, params[0]))  
+        if ((chan->_mode & InviteOnly) && IsOperator(client, *chan))
             Join(invited, channel);
-        else if(IsBannedClient(invited,params[0]) && IsOperator(client, params[0]))
+        else if(IsBannedClient(invited, *chan) && IsOperator(client, *chan))
         {
             std::vector<std::string> par;
             par.push_back(params[0]);
@@ -39,7 +41,7 @@ void Server::Invite(Client &client, std::vector<std::string> params)
             sendServerToClient(invited, INVITE(client._nick,invited._nick,params[0]));
             Join(invited, channel);
         }
-        else if (!(_channels.at(params[0])->_mode & InviteOnly) && !IsBannedClient(invited,params[0]))
+        else if (!(chan->_mode & InviteOnly) && !IsBannedClient(invited, *chan))
         {
             sendServerToClient(client, RPL_INVITING(client._nick,invited._nick,params[0]));
             sendServerToClient(invited, INVITE(client._nick,invited._nick,params[0]));
@@ -50,11 +52,11 @@ void Server::Invite(Client &client, std::vector<std::string> params)
     }
     else
     {
-        if(!IsExistClient(params[1]))
+        if(!found)
             sendServerToClient(client, ERR_NOSUCHNICK(client._nick, params[1]));
-        else if(!IsExistChannel(params[0]))
+        else if(!chan)
             sendServerToClient(client, ERR_NOSUCHCHANNEL(client._nick, params[0]));
-        else if(!IsInChannel(client,params[0]))
+        else if(!IsInChannel(client, *chan))
             sendServerToClient(client,  ERR_NOTONCHANNEL(client._nick, params[0]));
     }
 }
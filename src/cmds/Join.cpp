@@ -14,47 +14,62 @@
 //ERR_INVITEONLYCHAN (473)*
 //ERR_CHANNELISFULL (471)*
 //ERR_USERONCHANNEL (443)*
-void Server::Join(Client &client,std::vector<std::string> params)
+void Server::Join(Client &client,const std::vector<std::string> &params)
 {
     if(client._status != UsernameRegistered)
       return sendServerToClient(client,ERR_NOTREGISTERED(client._nick));
     if (ParamsSizeControl(client, "JOIN", params, 1, 1) != 0)
         return;
-    if (IsExistChannel(params[0]))
+    Channel *chan = findChannel(params[0]);
+    if (chan)
     {
-        if (IsInChannel(client, params[0]))
-            sendServerToClient(client, ERR_USERONCHANNEL(client._nick, params[1], params[0]));
-        else if (IsBannedClient(client, params[0]))
+        // A channel restored at startup has no operator. A nick proves
+        // nothing, so the recorded op is only given back to a joiner under
+        // that nick who logged in with OPER and passes +l, +i and +k.
+        bool reclaims = chan->getOperator() == NULL && client._isOper && chan->_operatorNick == client._foldedNick;
+        if (IsInChannel(client, *chan))
+            sendServerToClient(client, ERR_USERONCHANNEL(client._nick, client._nick, params[0]));
+        else if (HasTooManyChannels(client))
+            sendServerToClient(client,ERR_TOOMANYCHANNELS(client._nick, params[0]));
+        else if (IsBannedClient(client, *chan))
             sendServerToClient(client,ERR_BANNEDFROMCHAN(client._nick, params[0]));
-        else if (IsChannelLimitFull(params[0]))
+        else if (IsChannelLimitFull(*chan))
             sendServerToClient(client,ERR_CHANNELISFULL(client._nick, params[0]));
-        else if (_channels.at(params[0])->_mode & InviteOnly && client._invitedchan != params[0])
+        else if (chan->_mode & InviteOnly && !IsInvited(client, *chan))
             sendServerToClient(client,ERR_INVITEONLYCHAN(client._nick, params[0]));
-        else if (params.size() < 2 && HasChannelKey(params[0]))
+        else if (params.size() < 2 && HasChannelKey(*chan))
             sendServerToClient(client,ERR_BADCHANNELKEY(client._nick, params[0]));
-        else if (params.size() == 2 && !PasswordMatched(_channels.at(params[0])->getKey(), params[1]))
+        else if (params.size() == 2 && !PasswordMatched(chan->getKey(), params[1]))
             sendServerToClient(client,ERR_BADCHANNELKEY(client._nick, params[0]));
         else
         {
             client._invitedchan = "";
-            _channels.at(params[0])->addMember(client);
-            sendServerToChannel(params[0], JOIN(client._nick, params[0])); //sendServerToCLient olabilir
-            Topic(client, std::vector<std::string>(1,params[0]));
-            Names(client, std::vector<std::string>(1,params[0]));
+            chan->addMember(client);
+            sendChannelEvent(*chan, NULL, JOIN(client._nick, chan->_name)); //sendServerToCLient olabilir
+            if (reclaims)
+            {
+                chan->setOperator(&client);
+                sendServerToChannel(*chan, MODE(std::string("ircserv"), chan->_name, "+o", client._nick));
+            }
+            Topic(client, std::vector<std::string>(1,chan->_name));
+            Names(client, std::vector<std::string>(1,chan->_name));
         }
     }
     else
     {
         if (InvalidLetter(params[0]) || params[0][0] != '#')
             sendServerToClient(client, ERR_UNKNOWNERROR(client._nick, "JOIN", "Forbidden letter in use as Channel name or didn't use #."));
-        else if (client._channel.size() == 4)
+        else if (HasTooManyChannels(client))
             sendServerToClient(client,ERR_TOOMANYCHANNELS(client._nick, params[0]));
         else
         {
-            Channel* newish = new Channel(params[0],client);
-            _channels.insert(std::make_pair(std::string(params[0]), newish));
-            sendServerToClient(client, JOIN(client._nick, params[0]));
+            Channel* newish = _channelPool.acquire();
+            newish->reset(params[0], client);
+            newish->_history.reset(_config.historyLength);
+            _channels.insert(std::make_pair(newish->_foldedName, newish));
+            JournalCreate(*newish);
             newish->addMember(client);
+            sendChannelEvent(*newish, NULL, JOIN(client._nick, params[0]));
            if(params.size() == 2)
            {
                 std::vector<std::string> vec;
@@ -7,30 +7,34 @@
 //ERR_NOTONCHANNEL (442)*
 
 
-void Server::Kick(Client &client, std::vector<std::string> params)
+void Server::Kick(Client &client, const std::vector<std::string> &params)
 {
     if(client._status != UsernameRegistered)
         return sendServerToClient(client,ERR_NOTREGISTERED(client._nick));
-    if (ParamsSizeControl(client, "KICK", params, 2, 0) != 0)
+    if (ParamsSizeControl(client, "KICK", params, 2, 1) != 0)
         return;
-    if(IsExistChannel(params[0]) && IsExistClient(params[1]) && IsInChannel(client, params[0]) && IsOperator(client, params[0]))
+    Client *found = findClient(params[1]);
+    Channel *chan = findChannel(params[0]);
+    if(chan && found && IsInChannel(client, *chan) && IsOperator(client, *chan))
     {
-        Client &kicked = findClient(params[1]);
-        if(IsInChannel(kicked, params[0]) &&  !IsOperator(kicked, params[0]))
+        Client &kicked = *found;
+        if(IsInChannel(kicked, *chan) &&  !IsOperator(kicked, *chan))
         {
-            sendServerToChannel(params[0], KICK(client._nick, params[0], kicked._nick));
-            client._channel.at(params[0])->removeMember(kicked);
+            // Without a reason the kicker's nick is given, as most servers do
+            const std::string &reason = (params.size() > 2) ? params[2] : client._nick;
+            sendServerToChannel(*chan, KICK(client._nick, chan->_name, kicked._nick, reason));
+            chan->removeMember(kicked);
         }
         else
             sendServerToClient(client, ERR_USERNOTINCHANNEL(client._nick, params[1], params[0]));
     }
     else
     {
-        if (!IsExistChannel(params[0]))
+        if (!chan)
             sendServerToClient(client, ERR_NOSUCHCHANNEL(client._nick, params[0]));
-        else if (!IsInChannel(client, params[0]))
+        else if (!IsInChannel(client, *chan))
             sendServerToClient(client, ERR_NOTONCHANNEL(client._nick, params[0]));
         else
-            sendServerToClient(client, ERR_CHANOPRIVSNEEDED(client._nick, client._channel.at(params[0])->_name));
+            sendServerToClient(client, ERR_CHANOPRIVSNEEDED(client._nick, chan->_name));
     }
 }
@@ -10,6 +10,8 @@
 
 //Ban List "+b": Ban lists are returned with zero or more RPL_BANLIST (367) numerics,
 // followed by one RPL_ENDOFBANLIST (368) numeric.
+//Exception List "+e": RPL_EXCEPTLIST (348) and RPL_ENDOFEXCEPTLIST (349)
+//Invite Exception List "+I": RPL_INVEXLIST (346) and RPL_ENDOFINVEXLIST (347)
 
 
 //MODE #foobar
@@ -22,7 +24,11 @@
 //MODE #foobar -k
 //MODE #foobar +k 123sfsg4
 //MODE #foobar -b bunny
-//MODE #foobar +b bunny
+//MODE #foobar +b bunny          same as +b bunny!*@*
+//MODE #foobar +b *!*@10.0.0.*
+//MODE #foobar +e bunny!bun@*
+//MODE #foobar +I *!*@trusted.host
+//MODE #foobar b                 list the bans
 //MODE +o JOIN ile ilk channnel kurulunca
 const std::map<char, int> ModeMap()
 {
@@ -34,7 +40,36 @@ const std::map<char, int> ModeMap()
     return modes;
 }
 
-void Server::Mode(Client &client, std::vector<std::string> params)
+// "b", "+b", "e" or "I" without a mask asks for the list
+static char ListQuery(const std::string &ModeString)
+{
+    std::string letter = (ModeString[0] == '+') ? ModeString.substr(1) : ModeString;
+    if (letter == "b" || letter == "e" || letter == "I")
+        return letter[0];
+    return 0;
+}
+
+void Server::SendMaskList(Client &client, Channel &chan, char mode)
+{
+    const MaskList &list = *chan.getMaskList(mode);
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        if (mode == 'b')
+            sendServerToClient(client, RPL_BANLIST(client._nick, chan._name, list[i]));
+        else if (mode == 'e')
+            sendServerToClient(client, RPL_EXCEPTLIST(client._nick, chan._name, list[i]));
+        else
+            sendServerToClient(client, RPL_INVEXLIST(client._nick, chan._name, list[i]));
+    }
+    if (mode == 'b')
+        sendServerToClient(client, RPL_ENDOFBANLIST(client._nick, chan._name));
+    else if (mode == 'e')
+        sendServerToClient(client, RPL_ENDOFEXCEPTLIST(client._nick, chan._name));
+    else
+        sendServerToClient(client, RPL_ENDOFINVEXLIST(client._nick, chan._name));
+}
+
+void Server::Mode(Client &client, const std::vector<std::string> &params)
 {
     if(client._status != UsernameRegistered)
         return sendServerToClient(client,ERR_NOTREGISTERED(client._nick));
@@ -42,46 +77,55 @@ void Server::Mode(Client &client, std::vector<std::string> params)
         return;      
     size_t count = params.size();
     const std::map<char, int>& modes = ModeMap();
-    if (IsExistChannel(params[0]))
+    Channel *chan = findChannel(params[0]);
+    if (chan)
     {
         std::string modestr = "+";
         for (std::map<char, int>::const_iterator it = modes.begin(); it != modes.end(); it++)
         {
-            if (_channels.at(params[0])->_mode & it->second)
+            if (chan->_mode & it->second)
                 modestr += it->first;
         }
         if (count == 1)
-            sendServerToClient(client, RPL_CHANNELMODEIS(client._nick, params[0], modestr));
-        else if (IsOperator(client, params[0]))
+            sendServerToClient(client, RPL_CHANNELMODEIS(client._nick, chan->_name, modestr));
+        else if (count == 2 && ListQuery(params[1]))
+            SendMaskList(client, *chan, ListQuery(params[1]));
+        else if (IsOperator(client, *chan))
         {
             if(count == 2)
             {
-                if (_channels.at(params[0])->ChangeModeTwoParams(params[1], modes))
-                   sendServerToChannel(params[0], MODE(client._nick, params[0], params[1], "")); 
+                int before = chan->_mode;
+                if (chan->ChangeModeTwoParams(params[1], modes))
+                {
+                    // Setting a mode that is set, or unsetting one that is not, changes nothing
+                    if (chan->_mode != before)
+                    {
+                        JournalModes(*chan);
+                        sendServerToChannel(*chan, MODE(client._nick, chan->_name, params[1], ""));
+                    }
+                }
                 else
                     sendServerToClient(client, ERR_UNKNOWNMODE(client._nick, params[1]));
             }
             else if(count == 3)
             {
-                if (_channels.at(params[0])->ChangeModeThreeParams(params[1], params[2], modes))
-                    sendServerToChannel(params[0], MODE(client._nick, params[0], params[1], params[2])); 
-                else if (IsExistClient(params[2]) && _channels.at(params[0])->ChangeBannedMode(findClient(params[2]),params[1], IsBannedClient(findClient(params[2]), params[0])))
+                std::string mask = NormalizeMask(params[2]);
+                if (chan->ChangeModeThreeParams(params[1], params[2], modes, _config.maxChannelUsers))
+                {
+                    JournalModes(*chan);
+                    sendServerToChannel(*chan, MODE(client._nick, chan->_name, params[1], params[2]));
+                }
+                else if (chan->ChangeMaskMode(params[1], mask))
                 {
-                    sendServerToChannel(params[0], MODE(client._nick, params[0], params[1], params[2])); 
-                    std::vector<Client*>::iterator it = _channels.at(params[0])->getBanned().begin();
-                    std::vector<Client*>::iterator end = _channels.at(params[0])->getBanned().end();
-                    for (; it != end; it++)
-                        sendServerToClient(client, RPL_BANLIST(client._nick, params[0], (*it)->_nick));
-                    sendServerToClient(client, RPL_ENDOFBANLIST(client._nick, params[0]));
+                    JournalMask(*chan, params[1][1], params[1][0] == '+', mask);
+                    sendServerToChannel(*chan, MODE(client._nick, chan->_name, params[1], mask));
                 }
-                else if (!IsExistClient(params[2]))
-                    sendServerToClient(client, ERR_NOSUCHNICK(client._nick, params[2]));
                 else
                     sendServerToClient(client, ERR_UNKNOWNMODE(client._nick, params[1]));
              }
         }
         else
-            sendServerToClient(client, ERR_CHANOPRIVSNEEDED(client._nick, client._channel.at(params[0])->_name));
+            sendServerToClient(client, ERR_CHANOPRIVSNEEDED(client._nick, chan->_name));
     }
     else
         sendServerToClient(client, ERR_NOSUCHCHANNEL(client._nick, params[0]));
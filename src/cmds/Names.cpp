@@ -3,21 +3,32 @@
 //RPL_NAMREPLY (353)*
 //RPL_ENDOFNAMES (366)*
 
-void Server::Names(class Client & client,std::vector<std::string> params)
+void Server::Names(class Client & client,const std::vector<std::string> &params)
 {
     if(client._status != UsernameRegistered)
         return sendServerToClient(client,ERR_NOTREGISTERED(client._nick));
     if (ParamsSizeControl(client, "NAMES", params, 1, 0) != 0)
         return;
-    if (IsExistChannel(params[0]))
+    Channel *chan = findChannel(params[0]);
+    if (chan)
     {
-        std::string liststr = "@" +  _channels.at(params[0])->getOperator()->_nick;
-        for (std::vector<Client*>::iterator it =  _channels.at(params[0])->getMembers().begin() + 1; it !=  _channels.at(params[0])->getMembers().end(); ++it)
+        // Big channels need several 353 lines to stay under MAX_LINE_LENGTH
+        size_t budget = MAX_LINE_LENGTH - std::string(RPL_NAMREPLY(client._nick, chan->_name, "\r\n")).size();
+        // A restored channel has no operator until its one comes back
+        std::string liststr = chan->getOperator() ? "@" + chan->getOperator()->_nick : "";
+        for (IndexedSet<Client*>::iterator it = chan->getMembers().begin(); it != chan->getMembers().end(); ++it)
         {
-            liststr += " " + (*it)->_nick;
+            if (*it == chan->getOperator())
+                continue;
+            if (liststr.size() + 1 + (*it)->_nick.size() > budget)
+            {
+                sendServerToClient(client, RPL_NAMREPLY(client._nick, chan->_name, liststr));
+                liststr.clear();
+            }
+            liststr += (liststr.empty() ? "" : " ") + (*it)->_nick;
         }
-        sendServerToClient(client, RPL_NAMREPLY(client._nick, params[0], liststr));
-        sendServerToClient(client, RPL_ENDOFNAMES(client._nick, params[0]));
+        sendServerToClient(client, RPL_NAMREPLY(client._nick, chan->_name, liststr));
+        sendServerToClient(client, RPL_ENDOFNAMES(client._nick, chan->_name));
     }
     else
         sendServerToClient(client, RPL_ENDOFNAMES(client._nick, params[0]));
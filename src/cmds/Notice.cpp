@@ -1,6 +1,6 @@
 #include "../../inc/Server.hpp"
 
-void Server::Notice(class Client & server, std::vector<std::string> params)
+void Server::Notice(class Client & server, const std::vector<std::string> &params)
 {
     PrivMsg(server, params);
 }
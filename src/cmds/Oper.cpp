@@ -0,0 +1,22 @@
+#include "../../inc/Server.hpp"
+
+//RPL_YOUREOPER (381)*
+//ERR_NEEDMOREPARAMS (461)*
+//ERR_PASSWDMISMATCH (464)*
+//ERR_NOOPERHOST (491)*
+
+//OPER <name> <password>
+void Server::Oper(Client &client, const std::vector<std::string> &params)
+{
+    if (client._status != UsernameRegistered)
+        return sendServerToClient(client, ERR_NOTREGISTERED(client._nick));
+    if (ParamsSizeControl(client, "OPER", params, 2, 0) != 0)
+        return;
+    if (_config.operName.empty() || params[0] != _config.operName)
+        return sendServerToClient(client, ERR_NOOPERHOST(client._nick));
+    if (!PasswordMatched(_config.operPassword, params[1]))
+        return sendServerToClient(client, ERR_PASSWDMISMATCH(client._nick));
+    client._isOper = true;
+    LOG_INFO("%s is now an operator", client._nick.c_str());
+    sendServerToClient(client, RPL_YOUREOPER(client._nick));
+}
@@ -3,7 +3,7 @@
 // ERR_NEEDMOREPARAMS(Command)*
 // ERR_ALREADYREGISTERED()*
 // ERR_PASSWDMISMATCH()*
-void Server::Pass(Client &client, std::vector<std::string> params)
+void Server::Pass(Client &client, const std::vector<std::string> &params)
 {
     if (ParamsSizeControl(client, "PASS", params, 1, 0) != 0)
         return;
@@ -13,7 +13,7 @@ void Server::Pass(Client &client, std::vector<std::string> params)
         if (PasswordMatched(this->getPassword(), params[0]))
         {
             client._status = PassRegistered;
-            std::cout << "Pass assigned" << "\n";
+            LOG_DEBUG("Pass assigned");
         }
         else
             sendServerToClient(client, ERR_PASSWDMISMATCH(client._nick));
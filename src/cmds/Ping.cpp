@@ -2,8 +2,10 @@
 
 //ERR_NEEDMOREPARAMS(Command)
 
-void Server::Ping(Client &client, std::vector<std::string> params)
+void Server::Ping(Client &client, const std::vector<std::string> &params)
 {
+    if (ParamsSizeControl(client, "PING", params, 1, 0) != 0)
+        return;
 /*     if (IsExistClient(params[0]))
     {
         sendServerToClient(findClient(params[0]), ":" + client._nick + " PONG " + params[2]);
@@ -0,0 +1,7 @@
+#include "../../inc/Server.hpp"
+
+// Every line a client sends counts as a sign of life (see ClientTimeout),
+// PONG only has to be accepted.
+void Server::Pong(Client &, const std::vector<std::string> &)
+{
+}
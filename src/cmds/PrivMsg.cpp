@@ -19,7 +19,7 @@
 
  //PRIVMSG @#wez
  
-void Server::PrivMsg(class Client &client, std::vector<std::string > params)
+void Server::PrivMsg(class Client &client, const std::vector<std::string> &params)
 {
     if(client._status != UsernameRegistered)
         return sendServerToClient(client,ERR_NOTREGISTERED(client._nick));
@@ -30,35 +30,35 @@ void Server::PrivMsg(class Client &client, std::vector<std::string > params)
         return sendServerToClient(client, ERR_NORECIPIENT(client._nick, "PRIVMSG"));
 
     enum Prefix pre = PrefixControl(params[0]);
-    std::string message = (params[1][0] == ':') ? params[1].substr(1) : params[1];
+    Channel *chan;
+    std::string message = params[1];
     for (size_t i = 2; i < count; i++)
             message += " " + params[i];
     switch (pre)
     {
     case PrefixClient:
-        if(IsExistClient(params[0]))
-        {
-            Client& toClient = findClient(params[0]);
-            sendServerToClient(toClient, PRIVMSG(client._nick, toClient._nick, message));
-        }
+        if(Client *toClient = findClient(params[0]))
+            sendServerToClient(*toClient, PRIVMSG(client._nick, toClient->_nick, message));
         else
             sendServerToClient(client,ERR_NOSUCHNICK(client._nick, params[0]));
         break;
     case PrefixChannelOp:
-        if (IsExistChannel(params[1].substr(1)) && !IsBannedClient(client,params[0]))
+        chan = findChannel(params[0].substr(1));
+        if (chan && chan->getOperator() && !IsBannedClient(client, *chan))
         {
-            Client& op = *_channels.at(params[1].substr(1))->getOperator();
+            Client& op = *chan->getOperator();
             sendServerToClient(op, PRIVMSG(client._nick, op._nick, message));
         }
-        else if(IsBannedClient(client,params[1].substr(1)))
-            sendServerToClient(client,ERR_CANNOTSENDTOCHAN(client._nick,params[1].substr(1)));
+        else if(chan)
+            sendServerToClient(client,ERR_CANNOTSENDTOCHAN(client._nick,params[0].substr(1)));
         else
-            sendServerToClient(client,ERR_NOSUCHCHANNEL(client._nick,params[1].substr(1)));
+            sendServerToClient(client,ERR_NOSUCHCHANNEL(client._nick,params[0].substr(1)));
         break;
     case PrefixChannel:
-        if(IsExistChannel(params[0]) && IsInChannel(client,params[0]) && !IsBannedClient(client,params[0]))
-            sendClientToChannel(client,params[0], PRIVMSG(client._nick, params[0], message));
-        else if(!IsInChannel(client,params[0]) || IsBannedClient(client,params[0]))
+        chan = findChannel(params[0]);
+        if(chan && IsInChannel(client, *chan) && !IsBannedClient(client, *chan))
+            sendChannelEvent(*chan, &client, PRIVMSG(client._nick, chan->_name, message));
+        else if(chan)
             sendServerToClient(client,ERR_CANNOTSENDTOCHAN(client._nick,params[0]));
         else
             sendServerToClient(client,ERR_NOSUCHCHANNEL(client._nick, params[0]));
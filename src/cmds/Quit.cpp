@@ -2,21 +2,17 @@
 
 // NONE*
 
-void Server::Quit(Client &client, std::vector<std::string>)
+// One QUIT line per peer, however many channels they share with the client,
+// then the client leaves its channels without a PART each
+void Server::Quit(Client &client, const std::vector<std::string> &params)
 {
     if(client._status != UsernameRegistered)
         return sendServerToClient(client,ERR_NOTREGISTERED(client._nick));
-        
-    // apart from channels
-    std::vector<std::string> chans;
-    for (std::map<std::string, Channel*>::iterator it = client._channel.begin(); it != client._channel.end(); it++)
-        chans.push_back(it->first);
-    for (std::vector<std::string>::iterator it = chans.begin(); it != chans.end(); it++)
-    {
-        std::vector<std::string> par;
-        par.push_back(*it);
-        Part(client, par);
-    }
+
+    std::string reason = params.empty() ? "Connection closed" : params[0];
+    sendClientToCommonPeers(client, QUIT(client._nick, reason));
+    while (!client._channel.empty())
+        RemoveFromChannel(client, *client._channel.begin()->second);
     // make client offline
     client._online = false;
 }
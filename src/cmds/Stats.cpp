@@ -0,0 +1,102 @@
+#include "../../inc/Server.hpp"
+#include <cstdio>
+
+const size_t STATS_TOP_CLIENTS = 10;
+
+static bool UsesMoreMemory(const Client *a, const Client *b)
+{
+    return a->memoryUsage() > b->memoryUsage();
+}
+
+//RPL_STATSCOMMANDS (212)*
+//RPL_ENDOFSTATS (219)*
+//RPL_STATSUPTIME (242)*
+//RPL_STATSDEBUG (249)*
+//ERR_NOPRIVILEGES (481)*
+
+//STATS m  lines handled per command
+//STATS l  command handler latency
+//STATS u  uptime
+//STATS q  the clients holding the most memory
+//STATS z  connections, traffic, writes, send queues and memory
+void Server::Stats(Client &client, const std::vector<std::string> &params)
+{
+    if (client._status != UsernameRegistered)
+        return sendServerToClient(client, ERR_NOTREGISTERED(client._nick));
+    if (ParamsSizeControl(client, "STATS", params, 1, 1) != 0)
+        return;
+    if (!client._isOper)
+        return sendServerToClient(client, ERR_NOPRIVILEGES(client._nick));
+
+    char line[256];
+    switch (params[0][0])
+    {
+    case 'm':
+        for (int id = 0; id < CommandCount; id++)
+        {
+            if (_metrics.commandCounts[id] == 0)
+                continue;
+            snprintf(line, sizeof(line), "%lu", _metrics.commandCounts[id]);
+            sendServerToClient(client, RPL_STATSCOMMANDS(client._nick, CommandTable[id].name, line));
+        }
+        break;
+    case 'l':
+        for (int id = 0; id < CommandCount; id++)
+        {
+            const Histogram &latency = _metrics.commandLatency[id];
+            if (latency.count() == 0)
+                continue;
+            snprintf(line, sizeof(line), "%s count=%lu p50=%.1fus p99=%.1fus p999=%.1fus max=%.1fus", CommandTable[id].name,
+                     latency.count(), latency.percentile(0.5) / 1e3, latency.percentile(0.99) / 1e3,
+                     latency.percentile(0.999) / 1e3, latency.max() / 1e3);
+            sendServerToClient(client, RPL_STATSDEBUG(client._nick, line));
+        }
+        break;
+    case 'u':
+    {
+        long up = time(NULL) - _metrics.startTime;
+        snprintf(line, sizeof(line), "%ld days %ld:%02ld:%02ld", up / 86400, up / 3600 % 24, up / 60 % 60, up % 60);
+        sendServerToClient(client, RPL_STATSUPTIME(client._nick, line));
+        break;
+    }
+    case 'q':
+    {
+        std::vector<Client*> clients;
+        for (std::vector<Client*>::iterator it = _clients.begin(); it != _clients.end(); it++)
+            if (*it)
+                clients.push_back(*it);
+        size_t count = std::min(clients.size(), STATS_TOP_CLIENTS);
+        std::partial_sort(clients.begin(), clients.begin() + count, clients.end(), UsesMoreMemory);
+        for (size_t i = 0; i < count; i++)
+        {
+            snprintf(line, sizeof(line), "%s socket=%d sendq=%lu/%u memory=%lu", clients[i]->_nick.empty() ? "*" : clients[i]->_nick.c_str(),
+                     clients[i]->getSocketFd(), static_cast<unsigned long>(clients[i]->_sendQueueBytes), SendQueueLimit(*clients[i]),
+                     static_cast<unsigned long>(clients[i]->memoryUsage()));
+            sendServerToClient(client, RPL_STATSDEBUG(client._nick, line));
+        }
+        break;
+    }
+    case 'z':
+    {
+        SendQueueTotals queues = CountSendQueues();
+        snprintf(line, sizeof(line), "connections accepted=%lu closed=%lu current=%lu", _metrics.connectionsAccepted,
+                 _metrics.connectionsClosed, _metrics.connectionsAccepted - _metrics.connectionsClosed);
+        sendServerToClient(client, RPL_STATSDEBUG(client._nick, line));
+        snprintf(line, sizeof(line), "traffic bytes_in=%llu bytes_out=%llu", _metrics.bytesIn, BytesOut());
+        sendServerToClient(client, RPL_STATSDEBUG(client._nick, line));
+        snprintf(line, sizeof(line), "writes messages=%lu calls=%lu per_1k=%.1f", _metrics.messagesQueued, WriteCalls(),
+                 WriteCallsPer1k());
+        sendServerToClient(client, RPL_STATSDEBUG(client._nick, line));
+        snprintf(line, sizeof(line), "sendq clients=%lu messages=%lu bytes=%llu max=%llu dropped=%lu exceeded=%lu", queues.clients,
+                 queues.messages, queues.bytes, queues.maxBytes, DroppedSends(), _metrics.sendQueueExceeded);
+        sendServerToClient(client, RPL_STATSDEBUG(client._nick, line));
+        snprintf(line, sizeof(line), "memory clients=%llu max=%llu", queues.memory, queues.maxMemory);
+        sendServerToClient(client, RPL_STATSDEBUG(client._nick, line));
+        snprintf(line, sizeof(line), "channels=%lu unknown_commands=%lu flood_throttled=%lu log_dropped=%lu",
+                 static_cast<unsigned long>(_channels.size()), _metrics.unknownCommands, _metrics.floodThrottled, Logger::Dropped());
+        sendServerToClient(client, RPL_STATSDEBUG(client._nick, line));
+        break;
+    }
+    }
+    sendServerToClient(client, RPL_ENDOFSTATS(client._nick, params[0].substr(0, 1)));
+}
@@ -8,47 +8,49 @@
 //RPL_NOTOPIC (331)*
 //RPL_TOPIC (332)*
 
-void Server::Topic(Client &client, std::vector<std::string> params)
+void Server::Topic(Client &client, const std::vector<std::string> &params)
 {
     if(client._status != UsernameRegistered)
         return sendServerToClient(client,ERR_NOTREGISTERED(client._nick));
-    if (ParamsSizeControl(client, "TOPIC", params, 1, 10) != 0)  
-        return;
+    // not ParamsSizeControl, an empty trailing parameter clears the topic
+    if (params.empty() || params[0].empty())
+        return sendServerToClient(client, ERR_NEEDMOREPARAMS(client._nick, "TOPIC"));
+    if (params.size() > 2)
+        return sendServerToClient(client, ERR_UNKNOWNERROR(client._nick, "TOPIC", "Excessive argument is given"));
     size_t count = params.size();
     std::string message;
     if(count > 1)
-    {
-        message = (params[1][0] == ':') ? params[1].substr(1) : params[1];
-        for (size_t i = 2; i < count; i++)
-            message += " " + params[i];
-    }
-    if (IsExistChannel(params[0]) && IsInChannel(client, params[0]) && !IsBannedClient(client,params[0]))
+        message = params[1];
+    Channel *chan = findChannel(params[0]);
+    if (chan && IsInChannel(client, *chan) && !IsBannedClient(client, *chan))
     {
         if(count == 1)
         {
-            if (_channels.at(params[0])->_topic == "")
-                sendServerToClient(client, RPL_NOTOPIC(client._nick, params[0]));
+            if (chan->_topic == "")
+                sendServerToClient(client, RPL_NOTOPIC(client._nick, chan->_name));
             else
-                sendServerToClient(client, RPL_TOPIC(client._nick, params[0], _channels.at(params[0])->_topic));
+                sendServerToClient(client, RPL_TOPIC(client._nick, chan->_name, chan->_topic));
         }
-        else if ((_channels.at(params[0])->_mode & ProtectedTopic)  &&  IsOperator(client, params[0]))
+        else if ((chan->_mode & ProtectedTopic)  &&  IsOperator(client, *chan))
         {
-             _channels.at(params[0])->_topic = message;
-            sendServerToChannel(params[0], RPL_TOPIC(client._nick,params[0],message));
+             chan->_topic = message;
+            JournalTopic(*chan);
+            sendServerToChannel(*chan, RPL_TOPIC(client._nick,chan->_name,message));
         }
-        else if ((_channels.at(params[0])->_mode & ProtectedTopic))
-            sendServerToClient(client, ERR_CHANOPRIVSNEEDED(client._nick, params[0]));
+        else if ((chan->_mode & ProtectedTopic))
+            sendServerToClient(client, ERR_CHANOPRIVSNEEDED(client._nick, chan->_name));
         else
         {
-             _channels.at(params[0])->_topic = message;
-            sendServerToChannel(params[0], RPL_TOPIC(client._nick,params[0],message));
+             chan->_topic = message;
+            JournalTopic(*chan);
+            sendServerToChannel(*chan, RPL_TOPIC(client._nick,chan->_name,message));
         }
     }
     else
     {
-        if (!IsExistChannel(params[0]))
+        if (!chan)
             sendServerToClient(client, ERR_NOSUCHCHANNEL(client._nick, params[0]));
-        else if (!IsInChannel(client, params[0]))
+        else if (!IsInChannel(client, *chan))
             sendServerToClient(client, ERR_NOTONCHANNEL(client._nick, params[0]));
     }
 }
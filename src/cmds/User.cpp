@@ -6,11 +6,11 @@
 
 
 //USER Bit 0 * :realname
-void Server::User(Client &client, std::vector<std::string>params)
+void Server::User(Client &client, const std::vector<std::string> &params)
 {
     if (client._status < NickRegistered)
         return sendServerToClient(client, ERR_NOTREGISTERED(client._nick));
-    if (ParamsSizeControl(client, "USER", params, 3, 2) != 0)  
+    if (ParamsSizeControl(client, "USER", params, 3, 1) != 0)  
         return;
     size_t count = params.size();
     switch (client._status)
@@ -18,23 +18,17 @@ void Server::User(Client &client, std::vector<std::string>params)
     case NickRegistered:
         client._username = params[0];
         if(count > 3)
-        {
-            client._realname = params[3].substr(1);
-            for (size_t i = 4; i < count; i++)
-                client._realname += " " + params[i];
-        }
+            client._realname = params[3];
+        client.updateMask();
         client._status = UsernameRegistered;
-        std::cout << "Username assigned" << "\n";
+        LOG_DEBUG("Username assigned");
         break;
     case UsernameRegistered:
         client._username = params[0];
         if(count > 3)
-        {
-            client._realname = params[3].substr(1);
-            for (size_t i = 4; i < count; i++)
-                client._realname += " " + params[i];
-        }
-        std::cout << "Username changed" << "\n";
+            client._realname = params[3];
+        client.updateMask();
+        LOG_DEBUG("Username changed");
         break;
     default:
         break;
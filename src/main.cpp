@@ -1,14 +1,18 @@
 #include "../inc/Server.hpp"
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) 
+    if (argc != 3 && argc != 4) 
     {
-        std::cerr << "Usage: ./ircserv <port> <password>\n";
+        std::cerr << "Usage: ./ircserv <port> <password> [config]\n";
         return 1;
     }
     try
     {
-        Server IrcServ(argv[1],argv[2]);
+        Config config;
+        if (argc == 4)
+            config.Load(argv[3]);
+        Logger::Start(config.logLevel);
+        Server IrcServ(argv[1],argv[2], config);
         IrcServ.Listen().Run();  
     }
     catch(const std::exception& e)